@@ -164,11 +164,18 @@ bool Query_result_union_direct::postponed_prepare(
 
 
 /**
-  This class is effectively dead. It was used for non-DISTINCT UNIONs
-  in the pre-iterator executor. Now it exists only as a shell for certain
-  setup tasks, and should be removed.
+  Query result for the query blocks of an INTERSECT or EXCEPT whose rows can
+  be streamed straight to the unit's result, ie., there is no ORDER BY and we
+  are not the top unit of an INSERT ... SELECT.
+
+  The set operation iterators still use the unit's TABLE as their row format,
+  but the table is never instantiated; each output row is read by the unit's
+  root iterator and sent on as soon as it is produced. Duplicates are removed
+  by the set operation itself, so nothing here needs to look at the rows.
+  This object only forwards the setup and teardown calls that the query
+  blocks make on their result to the result that receives the rows.
 */
-class Query_result_intersect_direct final : public Query_result_intersect {
+class Query_result_intersect_streaming final : public Query_result_intersect {
 private:
     /// Result object that receives all rows
     Query_result* result;
@@ -179,7 +186,8 @@ private:
     bool execution_started;
 
 public:
-    Query_result_intersect_direct(Query_result* result, Query_block* last_query_block)
+    Query_result_intersect_streaming(Query_result* result,
+        Query_block* last_query_block)
         : Query_result_intersect(),
         result(result),
         optimized(false),
@@ -194,14 +202,12 @@ public:
     }
     bool postponed_prepare(THD* thd,
         const mem_root_deque<Item*>& types) override;
-    bool send_result_set_metadata(THD*, const mem_root_deque<Item*>&,
-        uint) override {
-        // Should never be called.
-        abort();
+    bool send_result_set_metadata(THD* thd, const mem_root_deque<Item*>& list,
+        uint flags) override {
+        return result->send_result_set_metadata(thd, list, flags);
     }
-    bool send_data(THD*, const mem_root_deque<Item*>&) override {
-        // Should never be called.
-        abort();
+    bool send_data(THD* thd, const mem_root_deque<Item*>& items) override {
+        return result->send_data(thd, items);
     }
     bool optimize() override {
         if (optimized) return false;
@@ -217,10 +223,7 @@ public:
     void send_error(THD* thd, uint errcode, const char* err) override {
         result->send_error(thd, errcode, err); /* purecov: inspected */
     }
-    bool send_eof(THD*) override {
-        // Should never be called.
-        abort();
-    }
+    bool send_eof(THD* thd) override { return result->send_eof(thd); }
     bool flush() override { return false; }
     bool check_simple_query_block() const override {
         // Only called for top-level Query_results, usually Query_result_send
@@ -241,13 +244,13 @@ public:
 
   @returns false if success, true if error
 */
-bool Query_result_intersect_direct::change_query_result(THD* thd,
+bool Query_result_intersect_streaming::change_query_result(THD* thd,
     Query_result* new_result) {
     result = new_result;
     return result->prepare(thd, *unit->get_unit_column_types(), unit);
 }
 
-bool Query_result_intersect_direct::postponed_prepare(
+bool Query_result_intersect_streaming::postponed_prepare(
     THD* thd, const mem_root_deque<Item*>& types) {
     if (result == nullptr) return false;
 
@@ -270,6 +273,70 @@ private:
     Query_block* saved_query_block;
 };
 
+/**
+  Returns the name a set operation compares a select list column by: the
+  column name for a column reference, and the name in the result otherwise.
+*/
+static const char* SetOperationColumnName(const Item* item) {
+    if (item->type() == Item::FIELD_ITEM || item->type() == Item::REF_ITEM)
+        return down_cast<const Item_ident*>(item)->field_name;
+    return item->item_name.ptr();
+}
+
+/**
+  Checks that all query blocks of a query expression with INTERSECT or EXCEPT
+  name their columns the same, in the same order.
+
+  @returns true on error
+*/
+static bool CheckSetOperationColumnNames(Query_block* first) {
+    for (Query_block* select = first->next_query_block();
+        select != nullptr; select = select->next_query_block())
+    {
+        auto first_it = first->visible_fields().begin();
+        for (Item* item : select->visible_fields())
+        {
+            if (first_it == first->visible_fields().end()) break;
+            const char* name1 = SetOperationColumnName(*first_it);
+            const char* name2 = SetOperationColumnName(item);
+            if (name1 == nullptr || name2 == nullptr ?
+                name1 != name2 : strcmp(name1, name2) != 0)
+            {
+                my_message(ER_WRONG_NUMBER_OF_COLUMNS_IN_SELECT, "The used SELECT statements have different column names or orders.", MYF(0));
+                return true;
+            }
+            ++first_it;
+        }
+    }
+    return false;
+}
+
+/**
+  Makes the sort order for merging the operands of an INTERSECT or EXCEPT:
+  ascending, on all the columns of the table they stream their rows into.
+
+  @param thd    Thread handle
+  @param fields The Item_fields of the table's visible columns
+
+  @returns the order, or nullptr on error
+*/
+static ORDER* MakeSetOperationOrder(THD* thd,
+    const mem_root_deque<Item*>& fields) {
+    ORDER* orders = thd->mem_root->ArrayAlloc<ORDER>(fields.size());
+    if (orders == nullptr) return nullptr;
+    size_t i = 0;
+    for (Item* field : fields)
+    {
+        Item** ref = thd->mem_root->ArrayAlloc<Item*>(1, field);
+        if (ref == nullptr) return nullptr;
+        orders[i].item = ref;
+        orders[i].direction = ORDER_ASC;
+        if (i > 0) orders[i - 1].next = &orders[i];
+        i++;
+    }
+    return orders;
+}
+
 /**
   Prepare the fake_query_block query block
 
@@ -327,7 +394,10 @@ bool Query_expression::prepare_fake_query_block(THD* thd_arg) {
 
 bool Query_expression::can_materialize_directly_into_result() const {
     // There's no point in doing this if we're not already trying to materialize.
-    if (!is_union() && !is_intersect()) {
+    // INTERSECT and EXCEPT (also when mixed with UNION) are not materialized
+    // query block by query block, so they cannot be written directly into the
+    // result either.
+    if (!is_union() || is_intersect_or_except()) {
         return false;
     }
 
@@ -383,13 +453,11 @@ bool Query_expression::prepare(THD* thd, Query_result* sel_result,
       bug#23022426.
     */
 
-    if (is_intersect())
+    if (is_intersect_or_except())
     {
-        m_intersect_needs_tmp_table = intersect_distinct != nullptr ||
-            global_parameters()->order_list.elements > 0 ||
-            ((thd->lex->sql_command == SQLCOM_INSERT_SELECT ||
-                thd->lex->sql_command == SQLCOM_REPLACE_SELECT) &&
-                thd->lex->unit == this);
+        // Duplicates are removed by the set operation itself, so DISTINCT
+        // alone does not need the temporary table.
+        m_intersect_needs_tmp_table = intersect_needs_tmp_table(thd->lex);
     }
     else
     {
@@ -402,23 +470,26 @@ bool Query_expression::prepare(THD* thd, Query_result* sel_result,
 
     // Create query result object for use by underlying query blocks
     if (!simple_query_expression) {
-        if (is_union() && !m_union_needs_tmp_table) {
-            if (!(tmp_result = union_result = new (thd->mem_root)
-                Query_result_union_direct(sel_result, last_query_block)))
+        // A UNION that is mixed with INTERSECT or EXCEPT is executed like
+        // them, so check for those first.
+        if (is_intersect_or_except() && !m_intersect_needs_tmp_table) {
+            if (!(tmp_result = intersect_result = new (thd->mem_root)
+                Query_result_intersect_streaming(sel_result, last_query_block)))
                 return true; /* purecov: inspected */
             if (fake_query_block != nullptr) fake_query_block = nullptr;
             instantiate_tmp_table = false;
         }
-        else if (is_intersect() && !m_intersect_needs_tmp_table) {
-            if (!(tmp_result = intersect_result = new (thd->mem_root)
-                Query_result_intersect_direct(sel_result, last_query_block)))
+        else if (is_union() && !is_intersect_or_except() &&
+            !m_union_needs_tmp_table) {
+            if (!(tmp_result = union_result = new (thd->mem_root)
+                Query_result_union_direct(sel_result, last_query_block)))
                 return true; /* purecov: inspected */
             if (fake_query_block != nullptr) fake_query_block = nullptr;
             instantiate_tmp_table = false;
         }
         else 
         {
-            if (is_intersect())
+            if (is_intersect_or_except())
             {
                 if (!(tmp_result = intersect_result = new (thd->mem_root) Query_result_intersect()))
                     return true; 
@@ -489,7 +560,7 @@ bool Query_expression::prepare(THD* thd, Query_result* sel_result,
           Use items list of underlaid select for derived tables to preserve
           information about fields lengths and exact types
         */
-        if (!is_union() && !is_intersect()) {
+        if (!is_union() && !is_intersect_or_except()) {
             types.clear();
             for (Item* item : first_query_block()->visible_fields()) {
                 types.push_back(item);
@@ -572,7 +643,7 @@ bool Query_expression::prepare(THD* thd, Query_result* sel_result,
       preparation of the underlying Query_result until column types are known.
     */
 
-    if (is_intersect())
+    if (is_intersect_or_except())
     {
         if (intersect_result != nullptr && intersect_result->postponed_prepare(thd, types))
             return true;
@@ -594,16 +665,18 @@ bool Query_expression::prepare(THD* thd, Query_result* sel_result,
         for (Item* type : types) {
             if (type->result_type() == STRING_RESULT &&
                 type->collation.derivation == DERIVATION_NONE) {
-                my_error(ER_CANT_AGGREGATE_NCOLLATIONS, MYF(0), "UNION or INTERSECT");
+                my_error(ER_CANT_AGGREGATE_NCOLLATIONS, MYF(0), "UNION, INTERSECT or EXCEPT");
                 return true;
             }
         }
         ulonglong create_options =
             first_query_block()->active_options() | TMP_TABLE_ALL_COLUMNS;
 
-        if (is_intersect())
+        if (is_intersect_or_except())
         {
-            if (intersect_result->create_result_table(thd, types, true, create_options, "", false, instantiate_tmp_table))
+            // No unique index; the set operation has already removed any
+            // duplicates, and INTERSECT ALL and EXCEPT ALL must keep theirs.
+            if (intersect_result->create_result_table(thd, types, false, create_options, "", false, instantiate_tmp_table))
                 return true;
 
             table = intersect_result->table;
@@ -633,6 +706,17 @@ bool Query_expression::prepare(THD* thd, Query_result* sel_result,
             if (table->fill_item_list(&item_list))
                 return true; /* purecov: inspected */
             assert(CountVisibleFields(item_list) == item_list.size());
+
+            // Like item_list, these outlive the executions of a prepared
+            // statement; reset_item_list() points the order's items at the
+            // table of each one.
+            if (is_intersect_or_except()) {
+                if (CheckSetOperationColumnNames(first_query_block()))
+                    return true;
+                m_set_operation_order = MakeSetOperationOrder(thd, item_list);
+                if (m_set_operation_order == nullptr)
+                    return true; /* purecov: inspected */
+            }
         }
         else {
             /*
@@ -668,6 +752,12 @@ bool Query_expression::optimize(THD* thd, TABLE* materialize_destination,
 
     ha_rows estimated_rowcount = 0;
     double estimated_cost = 0.0;
+    // The rows of the current operand of UNION or EXCEPT, of those before it,
+    // and whether it counts towards the estimate (it does not if it is the
+    // right-hand side of an EXCEPT).
+    ha_rows operand_rowcount = 0;
+    ha_rows other_operands_rowcount = 0;
+    bool operand_is_counted = false;
 
     if (query_result() != nullptr) query_result()->estimated_rowcount = 0;
 
@@ -685,11 +775,28 @@ bool Query_expression::optimize(THD* thd, TABLE* materialize_destination,
              rows).
           2. If GROUP BY clause is optimized away because it was a constant then
              query produces at most one row.
+          3. An INTERSECT returns no more rows than its smallest query block,
+             and an EXCEPT no more than its left-hand side. INTERSECT binds
+             tighter than UNION and EXCEPT, so each run of INTERSECT is one
+             operand of them.
          */
-        estimated_rowcount +=
+        const ha_rows query_block_rowcount =
             sl->is_implicitly_grouped() || sl->join->group_optimized_away
             ? 1
             : sl->join->best_rowcount;
+        if (sl->linkage == INTERSECT_TYPE && sl != first_query_block())
+        {
+            operand_rowcount = std::min(operand_rowcount, query_block_rowcount);
+        }
+        else
+        {
+            if (operand_is_counted) other_operands_rowcount += operand_rowcount;
+            operand_rowcount = query_block_rowcount;
+            operand_is_counted =
+                sl->linkage != EXCEPT_TYPE || sl == first_query_block();
+        }
+        estimated_rowcount = other_operands_rowcount +
+            (operand_is_counted ? operand_rowcount : 0);
         estimated_cost += sl->join->best_read;
 
         // TABLE_LIST::fetch_number_of_rows() expects to get the number of rows
@@ -706,7 +813,7 @@ bool Query_expression::optimize(THD* thd, TABLE* materialize_destination,
         }
     }
 
-    if (is_intersect())
+    if (is_intersect_or_except())
     {
         if (intersect_result && m_intersect_needs_tmp_table && !table->is_created())
         {
@@ -824,7 +931,7 @@ bool Query_expression::optimize(THD* thd, TABLE* materialize_destination,
 
     if (create_iterators) {
         JOIN* join;
-        if (!is_union()&& !is_intersect()) {
+        if (!is_union()&& !is_intersect_or_except()) {
             join = first_query_block()->join;
         }
         else if (fake_query_block != nullptr) {
@@ -849,7 +956,7 @@ bool Query_expression::optimize(THD* thd, TABLE* materialize_destination,
 
 bool Query_expression::force_create_iterators(THD* thd) {
     if (m_root_iterator == nullptr) {
-        JOIN* join = (is_union()|| is_intersect()) ? nullptr : first_query_block()->join;
+        JOIN* join = (is_union()|| is_intersect_or_except()) ? nullptr : first_query_block()->join;
         m_root_iterator = CreateIteratorFromAccessPath(
             thd, m_root_access_path, join, /*eligible_for_batch_mode=*/true);
     }
@@ -918,6 +1025,991 @@ Query_expression::setup_materialization(THD* thd, TABLE* dst_table,
     return query_blocks;
 }
 
+/**
+  Orders the children of an INTERSECT by increasing estimated number of rows,
+  keeping the syntactic order for ties. Children without an estimate go last.
+  The result is the same regardless of the order, but the first child drives
+  the merge and is the one HashIntersectIterator builds its hash table from,
+  so it should be the smallest one.
+*/
+static void OrderIntersectChildren(
+    Mem_root_array<IntersectPathParameters>* children) {
+    std::stable_sort(children->begin(), children->end(),
+        [](const IntersectPathParameters& a, const IntersectPathParameters& b) {
+            const double a_rows = a.path->num_output_rows;
+            const double b_rows = b.path->num_output_rows;
+            if (a_rows < 0.0) return false;
+            if (b_rows < 0.0) return true;
+            return a_rows < b_rows;
+        });
+}
+
+/**
+  Decides whether an INTERSECT DISTINCT can be executed by
+  HashIntersectIterator instead of by sorting and merging its children. If the
+  first (smallest) child does not fit in the join buffer after all, the hash
+  table is spilled to disk instead of growing (see SetOperationSpill), so all
+  it takes is rows that can be hashed, and estimates to compare the cost of
+  hashing them to the cost of merging.
+
+  @param children    The (streaming) children of the INTERSECT, ordered by
+                     OrderIntersectChildren()
+  @param table       The table the children stream their rows into
+  @param[out] cause  Why not, for the optimizer trace
+
+  @returns true if the first child can be hashed
+*/
+static bool CanHashIntersect(
+    const Mem_root_array<IntersectPathParameters>& children,
+    const TABLE* table, const char** cause) {
+    if (!CanUseNormalizedKeys(table)) {
+        *cause = "rows_cannot_be_hashed";
+        return false;
+    }
+
+    for (const IntersectPathParameters& child : children)
+    {
+        // No estimate, so play it safe.
+        if (child.path->num_output_rows < 0.0) {
+            *cause = "no_row_estimate";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  Gives a merged INTERSECT a Bloom filter over the rows of its first
+  (smallest) child, which the children that are estimated to be much larger
+  use to drop most of the rows that cannot be in the result before sorting
+  them; see SetOperationBloomFilter. A child gets the filter only if
+  IsBloomFilterWorthwhile(), and the filter must fit in the join buffer.
+
+  The filter is built while the first child is sorted, so it is not used if
+  that child is ordered already. Must be called before the children are given
+  their sorts.
+
+  @returns true on error
+*/
+static bool AddIntersectBloomFilters(THD* thd,
+    Mem_root_array<IntersectPathParameters>* children, TABLE* table) {
+    IntersectPathParameters& build_child = (*children)[0];
+    const double build_rows = build_child.path->num_output_rows;
+    if (build_child.is_ordered || build_rows < 0.0 ||
+        !CanUseNormalizedKeys(table))
+        return false;
+    if (build_rows * SetOperationBloomFilter::kBitsPerKey / 8 >
+        thd->variables.join_buff_size)
+        return false;
+
+    SetOperationBloomFilter* filter = nullptr;
+    for (size_t i = 1; i < children->size(); ++i)
+    {
+        IntersectPathParameters& child = (*children)[i];
+        if (child.is_ordered ||
+            !IsBloomFilterWorthwhile(build_rows, child.path->num_output_rows))
+            continue;
+        if (filter == nullptr)
+        {
+            filter = new (thd->mem_root) SetOperationBloomFilter(build_rows);
+            if (filter == nullptr) return true;
+        }
+        child.path = NewBloomFilterAccessPath(thd, child.path, filter, table,
+            /*build=*/false);
+        EstimateBloomFilterCost(child.path);
+    }
+
+    if (filter != nullptr)
+    {
+        build_child.path = NewBloomFilterAccessPath(thd, build_child.path,
+            filter, table, /*build=*/true);
+        EstimateBloomFilterCost(build_child.path);
+    }
+    return false;
+}
+
+/**
+  Marks every child of an EXCEPT after the first EXCEPT DISTINCT as distinct.
+  EXCEPT is left-associative, so once EXCEPT DISTINCT has been applied, there
+  is at most one copy of each row left, and a subsequent EXCEPT ALL removes it
+  exactly when EXCEPT DISTINCT would. Afterwards, the children up to the first
+  EXCEPT DISTINCT are EXCEPT ALL, and the rest are EXCEPT DISTINCT.
+*/
+static void PropagateExceptDistinct(
+    Mem_root_array<IntersectPathParameters>* children) {
+    bool distinct = false;
+    for (size_t i = 1; i < children->size(); ++i)
+    {
+        distinct |= (*children)[i].is_distinct;
+        (*children)[i].is_distinct = distinct;
+    }
+}
+
+/**
+  Decides whether an EXCEPT can be executed by HashExceptIterator instead of
+  by sorting and merging its children. The hash table can only count copies
+  for EXCEPT ALL or keep one for EXCEPT DISTINCT, not both, so all operators
+  must be of the same kind (after PropagateExceptDistinct()). Then, like for
+  INTERSECT, the rows must be hashable and have estimates, as the children
+  that are hashed are spilled to disk if they do not fit in the join buffer.
+  The exception is EXCEPT DISTINCT, whose hash table also holds the rows that
+  are returned, which cannot be spilled once the first child is being read;
+  those must be estimated to fit.
+
+  @param thd         Thread handle
+  @param children    The (streaming) children of the EXCEPT, in syntactic
+                     order
+  @param table       The table the children stream their rows into
+  @param[out] cause  Why not, for the optimizer trace
+
+  @returns true if the children but the first can be hashed
+*/
+static bool CanHashExcept(
+    THD* thd, const Mem_root_array<IntersectPathParameters>& children,
+    const TABLE* table, const char** cause) {
+    const bool distinct = children[1].is_distinct;
+    if (distinct != children.back().is_distinct) {
+        *cause = "mixes_all_and_distinct";
+        return false;
+    }
+    if (!CanUseNormalizedKeys(table)) {
+        *cause = "rows_cannot_be_hashed";
+        return false;
+    }
+
+    for (const IntersectPathParameters& child : children)
+    {
+        // No estimate, so play it safe.
+        if (child.path->num_output_rows < 0.0) {
+            *cause = "no_row_estimate";
+            return false;
+        }
+    }
+    if (!distinct) return true;
+
+    const double returned_bytes = children[0].path->num_output_rows *
+        (NormalizedKeyLength(table) + sizeof(NormalizedKey) + sizeof(size_t));
+    if (returned_bytes > thd->variables.join_buff_size) {
+        *cause = "result_exceeds_join_buffer";
+        return false;
+    }
+    return true;
+}
+
+/**
+  Returns true if the given child of an INTERSECT or EXCEPT is known to return
+  no rows. If it is any child of an INTERSECT or the first child of an EXCEPT,
+  neither does the set operation.
+*/
+static bool IsEmptyIntersectChild(const IntersectPathParameters& child) {
+    if (child.join == nullptr)  // A nested set operation.
+        return child.path->type == AccessPath::ZERO_ROWS;
+    return child.join->zero_result_cause != nullptr ||
+        child.join->root_access_path()->type == AccessPath::ZERO_ROWS;
+}
+
+/**
+  Checks whether the leading columns of “index” are exactly the select list of
+  “join”, in order and with the same definitions as the columns of the set
+  operation's table, so that values from that table can be used as keys for
+  the index without any conversion that changes their order or equality.
+*/
+static bool IndexLeadsWithSelectList(const JOIN* join, const KEY& index,
+    const TABLE* tmp_table) {
+    if (tmp_table->visible_field_count() > index.user_defined_key_parts)
+        return false;
+
+    uint i = 0;
+    for (Item* item : VisibleFields(*join->fields))
+    {
+        if (item->real_item()->type() != Item::FIELD_ITEM) return false;
+        const Field* field = down_cast<Item_field*>(item->real_item())->field;
+        const KEY_PART_INFO& part = index.key_part[i];
+        if (part.field != field || (part.key_part_flag & HA_PART_KEY_SEG) ||
+            !field->eq_def(tmp_table->visible_field_ptr()[i]))
+            return false;
+        i++;
+    }
+    return true;
+}
+
+/**
+  Checks whether an INTERSECT child is an ascending scan of an index whose
+  leading columns are exactly the child's select list, in order and with the
+  same definitions as the columns of the INTERSECT's table. If so, the child
+  already delivers its rows in merge order, and IntersectIterator can skip
+  ahead in it with index lookups.
+
+  @param param     The child; seek_table and seek_index are set on success
+  @param path      The child's access path, below any LIMIT
+  @param tmp_table The table the children stream their rows into
+
+  @returns true if the child is ordered by the index
+*/
+static bool IsIndexOrderedIntersectChild(IntersectPathParameters* param,
+    const AccessPath* path, const TABLE* tmp_table) {
+    // Without use_order, the scan does not promise to return rows in index
+    // order; e.g., a partitioned table need not merge its partitions.
+    if (path->type != AccessPath::INDEX_SCAN || !path->index_scan().use_order ||
+        path->index_scan().reverse)
+        return false;
+
+    TABLE* table = path->index_scan().table;
+    const uint idx = path->index_scan().idx;
+    const KEY& index = table->key_info[idx];
+    if (!(table->file->index_flags(idx, 0, true) & HA_READ_ORDER)) return false;
+
+    if (!IndexLeadsWithSelectList(param->join, index, tmp_table)) return false;
+
+    for (uint i = 0; i < tmp_table->visible_field_count(); i++)
+    {
+        if (index.key_part[i].key_part_flag & HA_REVERSE_SORT) return false;
+    }
+
+    // A LIMIT above the scan would stop the child after the rows we skip.
+    if (path == param->join->root_access_path())
+    {
+        param->seek_table = table;
+        param->seek_index = idx;
+    }
+    return true;
+}
+
+/**
+  Checks whether an INTERSECT DISTINCT child is a plain scan of one table,
+  possibly filtered by a WHERE condition, which has an index whose leading
+  columns are the child's select list (see IndexLeadsWithSelectList()). If so,
+  the INTERSECT can look the rows of the other children up in that index
+  instead of reading the child; see IntersectSemiJoinIterator.
+
+  @param child           The child
+  @param tmp_table       The table the children stream their rows into
+  @param[out] table      The table the child scans
+  @param[out] index      The index to look rows up in
+  @param[out] condition  The child's WHERE condition, or nullptr
+
+  @returns true if the child can be looked up in
+*/
+static bool FindSemiJoinLookup(const IntersectPathParameters& child,
+    const TABLE* tmp_table, TABLE** table, uint* index, Item** condition) {
+    if (child.join == nullptr) return false;
+
+    const AccessPath* path = child.join->root_access_path();
+    *condition = nullptr;
+    if (path->type == AccessPath::FILTER)
+    {
+        *condition = path->filter().condition;
+        path = path->filter().child;
+    }
+    switch (path->type)
+    {
+    case AccessPath::TABLE_SCAN:
+        *table = path->table_scan().table;
+        break;
+    case AccessPath::INDEX_SCAN:
+        *table = path->index_scan().table;
+        break;
+    default:
+        return false;
+    }
+    // Part of the condition may have been pushed to the engine, which only
+    // applies it to scans.
+    if ((*table)->file->pushed_cond != nullptr) return false;
+
+    for (uint idx = 0; idx < (*table)->s->keys; ++idx)
+    {
+        const KEY& key = (*table)->key_info[idx];
+        if (!(*table)->keys_in_use_for_query.is_set(idx) ||
+            (key.flags & (HA_FULLTEXT | HA_SPATIAL)))
+            continue;
+        if (IndexLeadsWithSelectList(child.join, key, tmp_table))
+        {
+            *index = idx;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+  Checks whether an INTERSECT child ends with a sort (e.g. from ORDER BY ...
+  LIMIT) on exactly its select list, ascending, and with the same ordering as
+  the columns of the INTERSECT's table.
+
+  @param param     The child
+  @param path      The child's access path, below any LIMIT
+  @param tmp_table The table the children stream their rows into
+
+  @returns true if the child's rows are sorted as the merge needs them
+*/
+static bool IsSortedIntersectChild(const IntersectPathParameters& param,
+    const AccessPath* path, const TABLE* tmp_table) {
+    if (path->type != AccessPath::SORT) return false;
+    const Filesort* filesort = path->sort().filesort;
+    if (filesort->sort_order_length() != tmp_table->visible_field_count())
+        return false;
+
+    uint i = 0;
+    for (Item* item : VisibleFields(*param.join->fields))
+    {
+        const st_sort_field& order = filesort->sortorder[i];
+        const Field* field = tmp_table->visible_field_ptr()[i];
+        if (order.reverse || order.item == nullptr ||
+            !order.item->real_item()->eq(item->real_item(), /*binary_cmp=*/false))
+            return false;
+        // The values are converted to the column types of the table before
+        // we compare them, so the conversion must keep the order.
+        if (item->result_type() != field->result_type()) return false;
+        if (item->result_type() == STRING_RESULT &&
+            (item->data_type() != field->type() ||
+                item->collation.collation != field->charset()))
+            return false;
+        i++;
+    }
+    return true;
+}
+
+/**
+  Finds out whether an INTERSECT child already delivers its rows in the order
+  the merge needs (ascending on all columns), so that it does not need a sort
+  of its own. Sets param->is_ordered, and if the child is an index scan that
+  the merge can seek in, param->seek_table and param->seek_index.
+
+  @param param     The child
+  @param tmp_table The table the children stream their rows into
+*/
+static void FindIntersectChildOrder(IntersectPathParameters* param,
+    const TABLE* tmp_table) {
+    // LIMIT keeps the order of the rows below it.
+    const AccessPath* path = param->join->root_access_path();
+    while (path->type == AccessPath::LIMIT_OFFSET)
+        path = path->limit_offset().child;
+
+    param->is_ordered =
+        IsIndexOrderedIntersectChild(param, path, tmp_table) ||
+        IsSortedIntersectChild(*param, path, tmp_table);
+}
+
+/**
+  Adds the operands of a set operation to the optimizer trace, in the order
+  the operator gets them: what each one is, and whether it is to be sorted
+  for the merge and why. Must be called before AddMergeSort().
+
+  @param trace     The optimizer trace
+  @param children  The operands
+  @param merged    True if the operands are merged, so that each of them may
+                   need a sort
+*/
+static void TraceSetOperationChildren(Opt_trace_context* trace,
+    const Mem_root_array<IntersectPathParameters>& children, bool merged) {
+    Opt_trace_array trace_children(trace, "children");
+    for (const IntersectPathParameters& child : children)
+    {
+        Opt_trace_object trace_child(trace);
+        if (child.join != nullptr)
+            trace_child.add_select_number(child.join->query_block->select_number);
+        else
+            trace_child.add_alnum("operand", "nested_set_operation");
+        trace_child.add("estimated_rows", child.path->num_output_rows);
+        if (child.path->type == AccessPath::BLOOM_FILTER)
+            trace_child.add_alnum("bloom_filter",
+                child.path->bloom_filter().build ? "build" : "probe");
+        if (!merged) continue;
+        trace_child.add("sorted", !child.is_ordered);
+        if (child.seek_table != nullptr)
+            trace_child.add_alnum("cause", "index_scan_in_merge_order");
+        else if (child.is_ordered)
+            trace_child.add_alnum("cause", "rows_in_merge_order");
+    }
+}
+
+/**
+  Adds a candidate algorithm for a set operation to the optimizer trace, with
+  its estimated cost, or with the reason why it cannot be used.
+
+  @param trace      The optimizer trace
+  @param algorithm  The algorithm
+  @param cost       Its estimated cost; ignored if “cause” is set
+  @param cause      Why it cannot be used, or nullptr if it can
+*/
+static void TraceSetOperationAlgorithm(Opt_trace_context* trace,
+    const char* algorithm, double cost, const char* cause) {
+    Opt_trace_object trace_algorithm(trace);
+    trace_algorithm.add_alnum("algorithm", algorithm);
+    if (cause != nullptr)
+        trace_algorithm.add("usable", false).add_alnum("cause", cause);
+    else
+        trace_algorithm.add("cost", cost);
+}
+
+/**
+  The Filesorts that sort operands of the set operations in one plan on the
+  merge order. They all sort the same table on the same order, so any
+  Filesort with the right remove_duplicates that no other sort in this plan
+  uses will do; those made by the plans of earlier executions (see
+  Query_expression::m_set_operation_sorts) are handed out before new ones are
+  made.
+*/
+struct SetOperationSorts {
+    /// The merge order, on the columns of “table”.
+    ORDER* order;
+    TABLE* table;
+    /// Query_expression::m_set_operation_sorts.
+    Mem_root_array<Filesort*>** filesorts;
+    /// How many of each of “filesorts” this plan has taken.
+    size_t num_used[2] = { 0, 0 };
+};
+
+/**
+  Returns a Filesort on the merge order that no other sort in the plan uses,
+  or nullptr on error. New ones are made on the statement MEM_ROOT, so that
+  later executions can use them again.
+*/
+static Filesort* GetSetOperationSort(THD* thd, SetOperationSorts* sorts,
+    bool remove_duplicates) {
+    Mem_root_array<Filesort*>*& filesorts =
+        sorts->filesorts[remove_duplicates];
+    size_t& num_used = sorts->num_used[remove_duplicates];
+    if (filesorts != nullptr && num_used < filesorts->size())
+    {
+        Filesort* filesort = (*filesorts)[num_used++];
+        // Any addon fields were set up by the sort of an earlier execution,
+        // on that execution's MEM_ROOT; let the next sort set them up anew.
+        filesort->addon_fields = nullptr;
+        return filesort;
+    }
+
+    Prepared_stmt_arena_holder ps_arena_holder(thd);
+    if (filesorts == nullptr)
+    {
+        filesorts = new (thd->mem_root) Mem_root_array<Filesort*>(thd->mem_root);
+        if (filesorts == nullptr) return nullptr;
+    }
+    Filesort* filesort = new (thd->mem_root)
+        Filesort(thd, { sorts->table }, /*keep_buffers=*/true,
+            sorts->order, HA_POS_ERROR, /*force_stable_sort=*/false,
+            remove_duplicates, false,
+            /*unwrap_rollup=*/false);
+    if (filesort == nullptr || filesorts->push_back(filesort)) return nullptr;
+    ++num_used;
+    return filesort;
+}
+
+/**
+  Sorts an operand of a merged INTERSECT or EXCEPT, unless it delivers its
+  rows in merge order already.
+
+  @param thd                Thread handle
+  @param param              The operand
+  @param sorts              The Filesorts of the plan
+  @param remove_duplicates  True if the number of copies of a row in this
+                            operand does not matter
+
+  @returns true on error
+*/
+static bool AddMergeSort(THD* thd, IntersectPathParameters* param,
+    SetOperationSorts* sorts, bool remove_duplicates) {
+    if (param->is_ordered) return false;
+
+    Filesort* filesort = GetSetOperationSort(thd, sorts, remove_duplicates);
+    if (filesort == nullptr) return true;
+
+    param->path = NewSortAccessPath(thd, param->path, filesort, true);
+    return false;
+}
+
+/**
+  Makes an operand of a set operation out of a query block, which streams its
+  rows into “table”.
+
+  @param thd     Thread handle
+  @param select  The query block
+  @param table   The table the operands stream their rows into
+*/
+static IntersectPathParameters MakeQueryBlockOperand(THD* thd,
+    Query_block* select, TABLE* table) {
+    JOIN* join = select->join;
+    assert(join && join->is_optimized());
+
+    IntersectPathParameters param;
+    param.path = NewStreamingAccessPath(thd, join->root_access_path(), join,
+        &join->tmp_table_param, table, -1);
+    param.join = join;
+    param.is_distinct = select->set_operation_distinct;
+    FindIntersectChildOrder(&param, table);
+
+    CopyCosts(*join->root_access_path(), param.path);
+    return param;
+}
+
+/**
+  Makes an operand of a set operation out of a nested one, in a query
+  expression that mixes them. It returns its rows in the fields of the same
+  table as the query blocks do. Merged INTERSECTs and EXCEPTs return them in
+  merge order, and so does the sort that removes the duplicates of a UNION
+  DISTINCT.
+*/
+static IntersectPathParameters MakeNestedOperand(AccessPath* path,
+    bool is_distinct) {
+    IntersectPathParameters param;
+    param.path = path;
+    param.join = nullptr;
+    param.is_distinct = is_distinct;
+    switch (path->type)
+    {
+    case AccessPath::INTERSECT:
+        param.is_ordered = !path->intersect().use_hash;
+        break;
+    case AccessPath::EXCEPT:
+        param.is_ordered = !path->except().use_hash;
+        break;
+    case AccessPath::SORT:
+    case AccessPath::ZERO_ROWS:
+        param.is_ordered = true;
+        break;
+    default:
+        param.is_ordered = false;
+        break;
+    }
+    return param;
+}
+
+static bool CreateIntersectSemiJoinPath(THD* thd,
+    const Mem_root_array<IntersectPathParameters>& children, TABLE* table,
+    SetOperationSorts* sorts, AccessPath** path);
+
+/**
+  Builds the access path of an INTERSECT of query blocks.
+
+  @param thd       Thread handle
+  @param children  The operands, from MakeQueryBlockOperand(); they are
+                   reordered
+  @param table     The table the operands stream their rows into
+  @param sorts     The Filesorts of the plan
+  @param distinct  True if any of the operators is INTERSECT DISTINCT, which
+                   makes all of them DISTINCT
+
+  @returns the access path, or nullptr on error
+*/
+static AccessPath* CreateIntersectPath(THD* thd,
+    Mem_root_array<IntersectPathParameters>* children, TABLE* table,
+    SetOperationSorts* sorts, bool distinct) {
+    Opt_trace_context* const trace = &thd->opt_trace;
+    Opt_trace_object trace_intersect(trace);
+    trace_intersect.add_alnum("operation", "intersect")
+        .add("distinct", distinct);
+
+    OrderIntersectChildren(children);
+    // As they stream, for planning a semi-join instead.
+    const Mem_root_array<IntersectPathParameters> streaming_children(
+        thd->mem_root, *children);
+
+    // Cost the merge before its children get their sorts, so that building
+    // it can be skipped if hashing is cheaper. Only INTERSECT DISTINCT can be
+    // hashed; the hash table keeps no duplicates.
+    AccessPath* path =
+        NewIntersectAccessPath(thd, children, table, /*use_hash=*/false,
+            distinct);
+    EstimateIntersectCost(path);
+    const double merge_cost = path->cost;
+    const char* hash_cause = "intersect_all_keeps_duplicates";
+    double hash_cost = -1.0;
+    bool use_hash = false;
+    if (distinct && CanHashIntersect(*children, table, &hash_cause))
+    {
+        hash_cause = nullptr;
+        AccessPath* hash_path =
+            NewIntersectAccessPath(thd, children, table, /*use_hash=*/true,
+                distinct);
+        EstimateIntersectCost(hash_path);
+        hash_cost = hash_path->cost;
+        use_hash = hash_cost < merge_cost;
+        if (use_hash) path = hash_path;
+    }
+
+    // Only merging requires the children to be sorted, and some of them may
+    // be sorted already. For INTERSECT DISTINCT, the merge skips duplicates
+    // itself, which is cheaper than having every sort remove them.
+    if (!use_hash)
+    {
+        if (AddIntersectBloomFilters(thd, children, table)) return nullptr;
+    }
+    TraceSetOperationChildren(trace, *children, !use_hash);
+    if (!use_hash)
+    {
+        for (IntersectPathParameters& child : *children)
+        {
+            if (AddMergeSort(thd, &child, sorts,
+                /*remove_duplicates=*/false))
+                return nullptr;
+        }
+        // With the Bloom filters, which may make it cheaper still.
+        EstimateIntersectCost(path);
+    }
+
+    Opt_trace_array trace_algorithms(trace, "considered_algorithms");
+    {
+        Opt_trace_object trace_merge(trace);
+        trace_merge.add_alnum("algorithm", "merge").add("cost", merge_cost);
+        if (!use_hash && path->cost != merge_cost)
+            trace_merge.add("cost_with_bloom_filters", path->cost);
+    }
+    TraceSetOperationAlgorithm(trace, "hash", hash_cost, hash_cause);
+
+    // If any child is known to be empty, so is the result, and there is no
+    // need to read (or sort) any of the others.
+    if (std::any_of(children->begin(), children->end(), IsEmptyIntersectChild))
+    {
+        path = NewZeroRowsAccessPath(thd, path,
+            "INTERSECT with an empty operand");
+        trace_algorithms.end();
+        trace_intersect.add_alnum("chosen", "zero_rows");
+        return path;
+    }
+
+    // INTERSECT DISTINCT can also be a semi-join, if one of the children can
+    // be looked up in an index instead of being read. Choose it if it is
+    // estimated to be cheaper.
+    bool use_semijoin = false;
+    if (distinct && path->cost >= 0.0)
+    {
+        // Not TraceSetOperationAlgorithm(), as planning the semi-join adds
+        // to the trace.
+        Opt_trace_object trace_semijoin(trace);
+        trace_semijoin.add_alnum("algorithm", "semijoin");
+        AccessPath* semijoin_path;
+        if (CreateIntersectSemiJoinPath(thd, streaming_children, table,
+            sorts, &semijoin_path))
+            return nullptr;
+        if (semijoin_path == nullptr)
+        {
+            trace_semijoin.add("usable", false)
+                .add_alnum("cause", "no_usable_lookup");
+        }
+        else
+        {
+            trace_semijoin.add("cost", semijoin_path->cost);
+            use_semijoin = semijoin_path->cost >= 0.0 &&
+                semijoin_path->cost < path->cost;
+            if (use_semijoin) path = semijoin_path;
+        }
+    }
+    else
+    {
+        TraceSetOperationAlgorithm(trace, "semijoin", -1.0,
+            distinct ? "no_row_estimate" : "intersect_all_keeps_duplicates");
+    }
+    trace_algorithms.end();
+    trace_intersect.add_alnum("chosen", use_semijoin ? "semijoin"
+        : use_hash ? "hash" : "merge");
+    return path;
+}
+
+/**
+  Builds an INTERSECT DISTINCT as a semi-join (see IntersectSemiJoinIterator),
+  if one of its children can be looked up in an index. The largest such child
+  is looked up in; the others are intersected on their own, and made free of
+  duplicates.
+
+  @param thd        Thread handle
+  @param children   The streaming children, ordered by
+                    OrderIntersectChildren()
+  @param table      The table the children stream their rows into
+  @param sorts      The Filesorts of the plan
+  @param[out] path  The access path, or nullptr if no child can be looked up
+                    in
+
+  @returns true on error
+*/
+static bool CreateIntersectSemiJoinPath(THD* thd,
+    const Mem_root_array<IntersectPathParameters>& children, TABLE* table,
+    SetOperationSorts* sorts, AccessPath** path) {
+    *path = nullptr;
+    TABLE* lookup_table = nullptr;
+    uint lookup_index = 0;
+    Item* condition = nullptr;
+    size_t lookup_child = children.size();
+    for (size_t i = children.size(); i-- > 0;)
+    {
+        if (FindSemiJoinLookup(children[i], table, &lookup_table, &lookup_index,
+            &condition))
+        {
+            lookup_child = i;
+            break;
+        }
+    }
+    if (lookup_child == children.size()) return false;
+
+    Opt_trace_context* const trace = &thd->opt_trace;
+    if (children[lookup_child].join != nullptr)
+    {
+        Opt_trace_object trace_lookup(trace, "lookup");
+        trace_lookup.add_select_number(
+            children[lookup_child].join->query_block->select_number);
+        if (lookup_table->pos_in_table_list != nullptr)
+            trace_lookup.add_utf8_table(lookup_table->pos_in_table_list);
+        trace_lookup.add_utf8("index", lookup_table->key_info[lookup_index].name);
+    }
+
+    auto* outer_children = new (thd->mem_root)
+        Mem_root_array<IntersectPathParameters>(thd->mem_root);
+    if (outer_children == nullptr) return true;
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        if (i != lookup_child && outer_children->push_back(children[i]))
+            return true;
+    }
+
+    IntersectPathParameters* outer = new (thd->mem_root) IntersectPathParameters;
+    if (outer == nullptr) return true;
+    if (outer_children->size() == 1)
+    {
+        *outer = (*outer_children)[0];
+        // A child that delivers its rows in merge order gets no sort, so
+        // nothing would remove its duplicates.
+        if (outer->is_ordered) return false;
+        if (AddMergeSort(thd, outer, sorts,
+            /*remove_duplicates=*/true))
+            return true;
+    }
+    else
+    {
+        Opt_trace_array trace_outer(trace, "outer");
+        AccessPath* outer_path =
+            CreateIntersectPath(thd, outer_children, table, sorts,
+                /*distinct=*/true);
+        if (outer_path == nullptr) return true;
+        *outer = MakeNestedOperand(outer_path, /*is_distinct=*/true);
+    }
+
+    *path = NewIntersectSemiJoinAccessPath(thd, outer, table, lookup_table,
+        lookup_index, condition);
+    EstimateIntersectSemiJoinCost(*path);
+    return false;
+}
+
+/**
+  Builds the access path of an EXCEPT.
+
+  @param thd       Thread handle
+  @param children  The operands, in syntactic order
+  @param table     The table the operands stream their rows into
+  @param sorts     The Filesorts of the plan
+
+  @returns the access path, or nullptr on error
+*/
+static AccessPath* CreateExceptPath(THD* thd,
+    Mem_root_array<IntersectPathParameters>* children, TABLE* table,
+    SetOperationSorts* sorts) {
+    Opt_trace_context* const trace = &thd->opt_trace;
+    Opt_trace_object trace_except(trace);
+    trace_except.add_alnum("operation", "except");
+
+    PropagateExceptDistinct(children);
+    const bool distinct = (*children)[1].is_distinct;
+
+    // Cost the merge before its children get their sorts, so that building
+    // it can be skipped if hashing is cheaper.
+    AccessPath* path = NewExceptAccessPath(thd, children, table,
+        /*use_hash=*/false, distinct);
+    EstimateExceptCost(path);
+    const double merge_cost = path->cost;
+    const char* hash_cause;
+    double hash_cost = -1.0;
+    bool use_hash = false;
+    if (CanHashExcept(thd, *children, table, &hash_cause))
+    {
+        hash_cause = nullptr;
+        AccessPath* hash_path = NewExceptAccessPath(thd, children, table,
+            /*use_hash=*/true, distinct);
+        EstimateExceptCost(hash_path);
+        hash_cost = hash_path->cost;
+        use_hash = hash_cost < merge_cost;
+        if (use_hash) path = hash_path;
+    }
+    TraceSetOperationChildren(trace, *children, !use_hash);
+
+    // Duplicates can be removed from any child whose number of copies of a
+    // row does not matter: the right-hand side of EXCEPT DISTINCT, and the
+    // first child if all the operators are EXCEPT DISTINCT.
+    if (!use_hash)
+    {
+        for (size_t i = 0; i < children->size(); i++)
+        {
+            const bool remove_duplicates = (*children)[i == 0 ? 1 : i].is_distinct;
+            if (AddMergeSort(thd, &(*children)[i], sorts,
+                remove_duplicates))
+                return nullptr;
+        }
+        EstimateExceptCost(path);
+    }
+    {
+        Opt_trace_array trace_algorithms(trace, "considered_algorithms");
+        TraceSetOperationAlgorithm(trace, "merge", merge_cost, nullptr);
+        TraceSetOperationAlgorithm(trace, "hash", hash_cost, hash_cause);
+    }
+    trace_except.add_alnum("chosen", use_hash ? "hash" : "merge");
+
+    if (IsEmptyIntersectChild((*children)[0]))
+    {
+        path = NewZeroRowsAccessPath(thd, path,
+            "EXCEPT with an empty left-hand operand");
+    }
+    return path;
+}
+
+/**
+  Builds the access path of a UNION in a query expression that mixes it with
+  INTERSECT or EXCEPT; other UNIONs are materialized or appended by
+  create_access_paths() itself. The operands are appended, but UNION is
+  left-associative, so the last UNION DISTINCT removes the duplicates of all
+  the operands up to it, by sorting them.
+
+  @param thd       Thread handle
+  @param children  The operands, in syntactic order
+  @param table     The table the operands stream their rows into
+  @param sorts     The Filesorts of the plan
+
+  @returns the access path, or nullptr on error
+*/
+static AccessPath* CreateUnionPath(THD* thd,
+    const Mem_root_array<IntersectPathParameters>& children, TABLE* table,
+    SetOperationSorts* sorts) {
+    size_t last_distinct = 0;
+    for (size_t i = 1; i < children.size(); i++)
+    {
+        if (children[i].is_distinct) last_distinct = i;
+    }
+
+    Opt_trace_context* const trace = &thd->opt_trace;
+    Opt_trace_object trace_union(trace);
+    trace_union.add_alnum("operation", "union");
+    TraceSetOperationChildren(trace, children, /*merged=*/false);
+    // The operands up to and including this one are sorted to remove
+    // duplicates, if there is a UNION DISTINCT.
+    if (last_distinct > 0)
+        trace_union.add("sorted_operands",
+            static_cast<ulonglong>(last_distinct + 1));
+
+    auto* operands = new (thd->mem_root)
+        Mem_root_array<AppendPathParameters>(thd->mem_root);
+    if (operands == nullptr) return nullptr;
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        AppendPathParameters param;
+        param.path = children[i].path;
+        param.join = children[i].join;
+        if (operands->push_back(param)) return nullptr;
+        if (i == 0 || i != last_distinct) continue;
+
+        AccessPath* path = NewAppendAccessPath(thd, operands);
+        EstimateAppendCost(path);
+        Filesort* filesort =
+            GetSetOperationSort(thd, sorts, /*remove_duplicates=*/true);
+        if (filesort == nullptr) return nullptr;
+
+        operands = new (thd->mem_root)
+            Mem_root_array<AppendPathParameters>(thd->mem_root);
+        if (operands == nullptr) return nullptr;
+        param.path = NewSortAccessPath(thd, path, filesort, true);
+        param.join = nullptr;
+        if (operands->push_back(param)) return nullptr;
+    }
+
+    if (operands->size() == 1) return (*operands)[0].path;
+    AccessPath* path = NewAppendAccessPath(thd, operands);
+    EstimateAppendCost(path);
+    return path;
+}
+
+/**
+  Builds the access path of a query expression with INTERSECT or EXCEPT,
+  possibly mixed with UNION. Its query blocks form a flat list, where the
+  linkage of each one is the operator to its left. INTERSECT binds tighter
+  than UNION and EXCEPT, which are left-associative, so every run of query
+  blocks joined by INTERSECT is one operand of a chain of UNION and EXCEPT
+  (the parser rejects parentheses that would group them any other way). The
+  chain is split into runs of the same operator, each of which becomes one
+  set operation whose first operand is the run before it.
+
+  The nested set operations return their rows in the fields of “table”, just
+  like the query blocks, so that every set operation streams its rows into
+  its parent's merge or append; nothing is materialized.
+
+  @param thd    Thread handle
+  @param first  The first query block
+  @param table  The table the operands stream their rows into
+  @param sorts  The Filesorts of the plan
+
+  @returns the access path, or nullptr on error
+*/
+static AccessPath* CreateSetOperationPath(THD* thd, Query_block* first,
+    TABLE* table, SetOperationSorts* sorts) {
+    // The operands of the current run of UNION or EXCEPT.
+    auto* operands = new (thd->mem_root)
+        Mem_root_array<IntersectPathParameters>(thd->mem_root);
+    if (operands == nullptr) return nullptr;
+    sub_select_type operation = UNSPECIFIED_TYPE;
+
+    for (Query_block* select = first; select != nullptr;)
+    {
+        // Find the run of INTERSECT that starts with this query block.
+        Query_block* end = select->next_query_block();
+        bool distinct = false;
+        while (end != nullptr && end->linkage == INTERSECT_TYPE)
+        {
+            distinct |= end->set_operation_distinct;
+            end = end->next_query_block();
+        }
+
+        IntersectPathParameters operand;
+        if (select->next_query_block() == end)
+        {
+            operand = MakeQueryBlockOperand(thd, select, table);
+        }
+        else
+        {
+            auto* children = new (thd->mem_root)
+                Mem_root_array<IntersectPathParameters>(thd->mem_root);
+            if (children == nullptr) return nullptr;
+            for (Query_block* sl = select; sl != end; sl = sl->next_query_block())
+            {
+                if (children->push_back(
+                    MakeQueryBlockOperand(thd, sl, table)))
+                    return nullptr;
+            }
+            AccessPath* path = CreateIntersectPath(thd, children, table,
+                sorts, distinct);
+            if (path == nullptr) return nullptr;
+            // The first query block tells the operator to the left of the
+            // INTERSECT as a whole.
+            operand = MakeNestedOperand(path, select->set_operation_distinct);
+        }
+
+        if (operands->size() > 1 && select->linkage != operation)
+        {
+            // The run so far becomes the first operand of the next one.
+            AccessPath* path = operation == EXCEPT_TYPE
+                ? CreateExceptPath(thd, operands, table, sorts)
+                : CreateUnionPath(thd, *operands, table, sorts);
+            if (path == nullptr) return nullptr;
+            operands = new (thd->mem_root)
+                Mem_root_array<IntersectPathParameters>(thd->mem_root);
+            if (operands == nullptr ||
+                operands->push_back(MakeNestedOperand(path, /*is_distinct=*/false)))
+                return nullptr;
+        }
+        if (select != first) operation = select->linkage;
+        if (operands->push_back(operand)) return nullptr;
+        select = end;
+    }
+
+    if (operands->size() == 1) return (*operands)[0].path;
+    return operation == EXCEPT_TYPE
+        ? CreateExceptPath(thd, operands, table, sorts)
+        : CreateUnionPath(thd, *operands, table, sorts);
+}
+
 bool Query_expression::create_access_paths(THD* thd) {
     if (is_simple()) {
         JOIN* join = first_query_block()->join;
@@ -957,10 +2049,13 @@ streaming_allowed = false;
     }
 
     TABLE* tmp_table;
-    if (is_intersect())
+    if (is_intersect_or_except())
     {
         tmp_table = intersect_result->table;
-        tmp_table->alias = "<intersect temporary>";  // HACK to assign temporary name
+        // HACK to assign temporary name
+        // (named after the first operator, if they are mixed)
+        tmp_table->alias = is_intersect() ? "<intersect temporary>"
+            : is_except() ? "<except temporary>" : "<union temporary>";
     }
     else
     {
@@ -977,122 +2072,83 @@ streaming_allowed = false;
     const bool calc_found_rows =
         (first_query_block()->active_options() & OPTION_FOUND_ROWS);
 
-    Mem_root_array<AppendPathParameters>* all_sub_paths;
-    Mem_root_array<IntersectPathParameters>* all_sub_paths_intersect;
-    if (is_intersect())
-    {
-        all_sub_paths_intersect = new (thd->mem_root) Mem_root_array<IntersectPathParameters>(thd->mem_root);
-    }
-    else
-    {
-        all_sub_paths = new (thd->mem_root) Mem_root_array<AppendPathParameters>(thd->mem_root);
-    }
-
     // If streaming is allowed, we can do all the parts that are UNION ALL by
     // streaming; the rest have to go to the table.
     //
     // Handle the query blocks that we need to materialize. This may be
     // UNION DISTINCT query blocks only, or all blocks.
 
-    if (is_intersect())
+    if (is_intersect_or_except())
     {
         for (Query_block* select = first_query_block(); select != nullptr; select = select->next_query_block())
-        {
-            if (select->linkage == UNION_TYPE)
-            {
-                my_message(ER_WRONG_NUMBER_OF_COLUMNS_IN_SELECT, "This version of MySQL does not support the mixture of \"union\" and \"intersect\".", MYF(0));
-                return true;
-            }
-        }
-
-        Query_block* first_all = first_query_block();
-
-        for (Query_block* select = first_all; select != nullptr;select = select->next_query_block())
         {
             JOIN* join = select->join;
             assert(join && join->is_optimized());
 
             ConvertItemsToCopy(*join->fields, tmp_table->visible_field_ptr(),
                 &join->tmp_table_param);
-
-            IntersectPathParameters param;
-            param.path = NewStreamingAccessPath(thd, join->root_access_path(), join,
-                &join->tmp_table_param, tmp_table, -1);
-            param.join = join;
-
-            CopyCosts(*join->root_access_path(), param.path);
-            all_sub_paths_intersect->push_back(param);
         }
-
-        assert(!all_sub_paths_intersect->empty());
-        ORDER* first = nullptr;
-        for (IntersectPathParameters* p = all_sub_paths_intersect->begin();p != all_sub_paths_intersect->end();p++)
+        Opt_trace_context* const trace = &thd->opt_trace;
+        Opt_trace_object trace_wrapper(trace);
+        Opt_trace_object trace_set_operation(trace, "set_operation_planning");
+        trace_set_operation.add_select_number(first_query_block()->select_number);
+        trace_set_operation.add("streaming", streaming_allowed);
+        if (!streaming_allowed)
+            trace_set_operation.add_alnum("cause",
+                global_parameters()->order_list.size() != 0
+                ? "order_by" : "insert_select");
         {
-            int num = p->join->tmp_table_param.copy_fields.size();
-            ORDER* orders = new ORDER[num];
-            for (int i = 0;i < num;i++)
+            Opt_trace_array trace_operations(trace, "operations");
+            // The Filesorts of earlier executions sort a table that is gone
+            // if this one has been prepared anew.
+            if (m_set_operation_sorts_table != tmp_table)
             {
-                int j = 0;
-                for (Item* h : *p->join->fields)
-                {
-                    if (j == i)
-                    {
-                        orders[i].item = new Item * [1]{ h };
-                        if (first != nullptr)
-                        {
-                            Item_ident *it1 = pointer_cast<Item_ident*>(first[i].item[0]);
-                            Item_ident* it2 = pointer_cast<Item_ident*>(orders[i].item[0]);
-                            if (strcmp(it1->field_name, it2->field_name)!=0)
-                            {
-                                my_message(ER_WRONG_NUMBER_OF_COLUMNS_IN_SELECT, "The used SELECT statements have different column names or orders.", MYF(0));
-                                return true;
-                            }                            
-                        }
-                        break;
-                    }
-                    j++;
-                }
-                orders[i].direction = ORDER_ASC;
-                if (i > 0)
-                {
-                    orders[i - 1].next = &orders[i];
-                }
+                m_set_operation_sorts[0] = m_set_operation_sorts[1] = nullptr;
+                m_set_operation_sorts_table = tmp_table;
             }
-            if (first == nullptr)
-                first = orders;
+            SetOperationSorts sorts{ m_set_operation_order, tmp_table,
+                m_set_operation_sorts };
+            m_root_access_path = CreateSetOperationPath(thd, first_query_block(),
+                tmp_table, &sorts);
+        }
+        if (m_root_access_path == nullptr) return true;
 
-            Filesort* filesort = new (thd->mem_root)
-                Filesort(thd, { tmp_table }, /*keep_buffers=*/true,
-                    orders, HA_POS_ERROR, /*force_stable_sort=*/false,
-                    /*remove_duplicates=*/intersect_distinct != nullptr, false,
-                    /*unwrap_rollup=*/false);
+        if (!streaming_allowed) {
+            // Write the result of the set operation into the temporary table
+            // and read it back, through the fake query block if we have one
+            // (it does the ORDER BY). The set operation writes its rows
+            // straight into the table's record, so there is nothing to copy.
+            AccessPath* table_path;
+            if (fake_query_block != nullptr) {
+                table_path = fake_query_block->join->root_access_path();
+            }
+            else {
+                table_path = NewTableScanAccessPath(thd, tmp_table,
+                    /*count_examined_rows=*/false);
+            }
+            bool push_limit_down =
+                global_parameters()->order_list.size() == 0 && !calc_found_rows;
 
-            p->path = NewSortAccessPath(thd, p->path, filesort, true);
-        }
-        m_root_access_path = NewIntersectAccessPath(thd, all_sub_paths_intersect, tmp_table);
-        /*
-        if (intersect_distinct != nullptr)
-        {
-            m_root_access_path = NewRemoveDuplicatesAccessPath(thd, m_root_access_path, tmp_table, tmp_table->key_info,
-                tmp_table->key_info->key_length);
+            AccessPath* set_operation_path = m_root_access_path;
+            m_root_access_path = NewMaterializeAccessPath(
+                thd,
+                SingleMaterializeQueryBlock(
+                    thd, set_operation_path, first_query_block()->select_number,
+                    /*join=*/nullptr, /*copy_fields_and_items=*/false,
+                    /*temp_table_param=*/nullptr),
+                /*invalidators=*/nullptr, tmp_table, table_path,
+                /*cte=*/nullptr, /*unit=*/nullptr,
+                /*ref_slice=*/-1,
+                /*rematerialize=*/true, push_limit_down ? limit : HA_POS_ERROR,
+                /*reject_multiple_rows=*/false);
+            m_root_access_path->materialize().bulk_insert = true;
+            EstimateMaterializeCost(m_root_access_path);
         }
-        */
     }
     else
     {
-        if (is_union())
-        {
-            for (Query_block* select = first_query_block(); select != nullptr; select = select->next_query_block())
-            {
-                if (select->linkage == INTERSECT_TYPE)
-                {
-                    my_message(ER_WRONG_NUMBER_OF_COLUMNS_IN_SELECT, "This version of MySQL does not support the mixture of \"union\" and \"intersect\".", MYF(0));
-                    return true;
-                }
-            }
-        }
-
         //union
+        auto* all_sub_paths = new (thd->mem_root) Mem_root_array<AppendPathParameters>(thd->mem_root);
         if (union_distinct != nullptr || !streaming_allowed) {
             Mem_root_array<MaterializePathParameters::QueryBlock> query_blocks =
                 setup_materialization(thd, tmp_table, streaming_allowed);
@@ -1116,6 +2172,7 @@ streaming_allowed = false;
                 /*ref_slice=*/-1,
                 /*rematerialize=*/true, push_limit_down ? limit : HA_POS_ERROR,
                 /*reject_multiple_rows=*/false);
+            param.path->materialize().bulk_insert = true;
             EstimateMaterializeCost(param.path);
             param.join = nullptr;
             all_sub_paths->push_back(param);
@@ -1206,7 +2263,7 @@ bool Query_expression::explain(THD* explain_thd, const THD* query_thd) {
     if (fake_query_block != nullptr) {
         // Don't save result as it's needed only for consequent exec.
 
-        if(is_intersect())
+        if(is_intersect_or_except())
             ret = explain_query_specification(explain_thd, query_thd, fake_query_block, CTX_INTERSECT_RESULT);
         else
             ret = explain_query_specification(explain_thd, query_thd, fake_query_block,CTX_UNION_RESULT);
@@ -1216,7 +2273,7 @@ bool Query_expression::explain(THD* explain_thd, const THD* query_thd) {
 
     if (ret) return true;
 
-    if (is_intersect())
+    if (is_intersect_or_except())
         fmt->end_context(CTX_INTERSECT);
     else
         fmt->end_context(CTX_UNION);
@@ -1516,7 +2573,7 @@ void Query_expression::cleanup(THD* thd, bool full) {
     }
 
     // fake_query_block's table depends on Temp_table_param inside union_result
-    if (is_intersect())
+    if (is_intersect_or_except())
     {
         if (full && intersect_result) {
             intersect_result->cleanup(thd);
@@ -1553,7 +2610,7 @@ void Query_expression::destroy() {
 
     if (fake_query_block) fake_query_block->destroy();
 
-    if (is_intersect())
+    if (is_intersect_or_except())
     {
         if (intersect_result != nullptr && table != nullptr) {
             free_tmp_table(table);
@@ -1638,11 +2695,11 @@ bool Query_expression::change_query_result(
 */
 
 mem_root_deque<Item*>* Query_expression::get_unit_column_types() {
-    return (is_union()||is_intersect()) ? &types : &first_query_block()->fields;
+    return (is_union()||is_intersect_or_except()) ? &types : &first_query_block()->fields;
 }
 
 size_t Query_expression::num_visible_fields() const {
-    return (is_union() || is_intersect()) ? CountVisibleFields(types)
+    return (is_union() || is_intersect_or_except()) ? CountVisibleFields(types)
         : first_query_block()->num_visible_fields();
 }
 
@@ -1662,7 +2719,7 @@ mem_root_deque<Item*>* Query_expression::get_field_list() {
     if (fake_query_block != nullptr) {
         return fake_query_block->join->fields;
     }
-    else if (is_union()|| is_intersect()) {
+    else if (is_union()|| is_intersect_or_except()) {
         return &item_list;
     }
     else {
@@ -1678,6 +2735,15 @@ bool Query_expression::mixed_intersect_operators() const {
     return intersect_distinct && intersect_distinct->next_query_block();
 }
 
+bool Query_expression::is_intersect_or_except() const {
+    for (const Query_block* sl = first_query_block()->next_query_block();
+        sl != nullptr; sl = sl->next_query_block()) {
+        if (sl->linkage == INTERSECT_TYPE || sl->linkage == EXCEPT_TYPE)
+            return true;
+    }
+    return false;
+}
+
 bool Query_expression::walk(Item_processor processor, enum_walk walk,
     uchar* arg) {
     for (auto select = first_query_block(); select != nullptr;
@@ -24,10 +24,12 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <atomic>
 #include <string>
 #include <vector>
 
+#include "my_byteorder.h"
 #include "my_inttypes.h"
 #include "scope_guard.h"
 #include "sql/basic_row_iterators.h"
@@ -42,11 +44,14 @@
 #include "sql/join_optimizer/access_path.h"
 #include "sql/join_optimizer/join_optimizer.h"
 #include "sql/key.h"
+#include "sql/mysqld.h"  // mysql_tmpdir
 #include "sql/opt_explain.h"
 #include "sql/opt_trace.h"
 #include "sql/pfs_batch_mode.h"
+#include "sql/psi_memory_key.h"
 #include "sql/sql_base.h"
 #include "sql/sql_class.h"
+#include "sql/sql_const.h"  // DISK_BUFFER_SIZE, TEMP_PREFIX
 #include "sql/sql_executor.h"
 #include "sql/sql_join_buffer.h"
 #include "sql/sql_lex.h"
@@ -811,6 +816,41 @@ bool MaterializeIterator::MaterializeQueryBlock(const QueryBlock &query_block,
     return true;
   }
 
+  // Let the engine write the rows a batch at a time, if asked to, unless the
+  // rows we have written must be found while we are still writing: by index
+  // lookups in check_unique_constraint(), or by reading the table, in a
+  // recursive CTE.
+  const bool use_bulk_insert =
+      query_block.use_bulk_insert && !doing_hash_deduplication() &&
+      !query_block.is_recursive_reference &&
+      (m_query_expression == nullptr || !m_query_expression->is_recursive());
+  bool bulk_insert_started = false;
+  const auto start_bulk_insert = [&] {
+    if (!use_bulk_insert) return;
+    const ha_rows expected_rows =
+        query_block.expected_rows > *stored_rows
+            ? query_block.expected_rows - *stored_rows
+            : 0;
+    table()->file->ha_start_bulk_insert(
+        m_limit_rows == HA_POS_ERROR
+            ? expected_rows
+            : std::min(expected_rows, m_limit_rows - *stored_rows));
+    bulk_insert_started = true;
+  };
+  // Writes out what the engine has buffered. Returns true on error.
+  const auto end_bulk_insert = [&] {
+    if (!bulk_insert_started) return false;
+    bulk_insert_started = false;
+    const int error = table()->file->ha_end_bulk_insert();
+    if (error == 0) return false;
+    table()->file->print_error(error, MYF(0)); /* purecov: inspected */
+    return true;                               /* purecov: inspected */
+  };
+  // Leave bulk insert mode on errors, too.
+  auto end_bulk_insert_guard =
+      create_scope_guard([&] { (void)end_bulk_insert(); });
+  start_bulk_insert();
+
   PFSBatchMode pfs_batch_mode(query_block.subquery_iterator.get());
   while (*stored_rows < m_limit_rows) {
     int error = query_block.subquery_iterator->Read();
@@ -842,12 +882,18 @@ bool MaterializeIterator::MaterializeQueryBlock(const QueryBlock &query_block,
     }
     // create_ondisk_from_heap will generate error if needed.
     if (!table()->file->is_ignorable_error(error)) {
+      // The rows the engine has buffered must be written before they are
+      // copied to the new table.
+      if (end_bulk_insert()) return true; /* purecov: inspected */
       bool is_duplicate;
+      // This also counts the table in Created_tmp_disk_tables, which the
+      // Performance Schema sums per statement.
       if (create_ondisk_from_heap(thd(), table(), error, true, &is_duplicate))
         return true; /* purecov: inspected */
       // Table's engine changed; index is not initialized anymore.
       if (table()->hash_field) table()->file->ha_index_init(0, false);
       if (!is_duplicate) ++*stored_rows;
+      start_bulk_insert();
 
       // Inform each reader that the table has changed under their feet,
       // so they'll need to reposition themselves.
@@ -863,7 +909,7 @@ bool MaterializeIterator::MaterializeQueryBlock(const QueryBlock &query_block,
     }
   }
 
-  return false;
+  return end_bulk_insert();
 }
 
 int MaterializeIterator::Read() {
@@ -956,7 +1002,13 @@ bool StreamingIterator::Init() {
   return m_subquery_iterator->Init();
 }
 
-int StreamingIterator::Read() {
+int StreamingIterator::Read() { return ReadOrCopyRow(/*read_row=*/true); }
+
+int StreamingIterator::CopyCurrentRow() {
+  return ReadOrCopyRow(/*read_row=*/false);
+}
+
+int StreamingIterator::ReadOrCopyRow(bool read_row) {
   /*
     Enable the items which one should use if one wants to evaluate
     anything (e.g. functions in WHERE, HAVING) involving columns of this
@@ -970,8 +1022,10 @@ int StreamingIterator::Read() {
     }
   });
 
-  int error = m_subquery_iterator->Read();
-  if (error != 0) return error;
+  if (read_row) {
+    int error = m_subquery_iterator->Read();
+    if (error != 0) return error;
+  }
 
   // Materialize items for this row.
   if (copy_fields_and_funcs(m_temp_table_param, thd())) return 1;
@@ -1677,20 +1731,80 @@ void AppendIterator::UnlockRow() {
 }
 
 
-IntersectIterator::IntersectIterator(
+SetOperationMergeIterator::SetOperationMergeIterator(
     THD* thd, std::vector<unique_ptr_destroy_only<RowIterator>>&& sub_iterators, 
-    TABLE* table)
+    TABLE* table, Mem_root_array<SeekInfo> seek_info, const char* operation)
     : RowIterator(thd), 
     m_sub_iterators(move(sub_iterators)),
-    m_table(table)
+    m_table(table),
+    m_seek_info(std::move(seek_info)),
+    m_child_stats(thd->mem_root, m_sub_iterators.size()),
+    m_field_offset(table->field[0]->ptr - table->record[0]),
+    m_use_normalized_keys(CanUseNormalizedKeys(table)),
+    m_key_length(m_use_normalized_keys ? NormalizedKeyLength(table) : 0),
+    m_operation(operation)
 {
     assert(!m_sub_iterators.empty());
+    assert(m_seek_info.size() == m_sub_iterators.size());
+
+    uint seek_key_length = 0;
+    for (const SeekInfo& seek : m_seek_info)
+    {
+        if (seek.table != nullptr)
+            seek_key_length = std::max(seek_key_length,
+                seek.table->key_info[seek.index].key_length);
+    }
+    if (seek_key_length > 0)
+        m_seek_key_buf = new (thd->mem_root) uchar[seek_key_length];
 }
 
-bool IntersectIterator::Init() 
+bool SetOperationMergeIterator::Init() 
 {
     m_pfs_batch_mode_enabled = false;
-    for (int i = 0;i < m_sub_iterators.size();i++)
+    const size_t num_children = m_sub_iterators.size();
+    if (m_row_bufs == nullptr)
+    {
+        m_row_bufs = thd()->mem_root->ArrayAlloc<uchar*>(num_children);
+        m_has_pending_row = thd()->mem_root->ArrayAlloc<bool>(num_children);
+        m_child_eof = thd()->mem_root->ArrayAlloc<bool>(num_children);
+        if (m_row_bufs == nullptr || m_has_pending_row == nullptr ||
+            m_child_eof == nullptr)
+            return true;
+        for (size_t i = 0; i < num_children; i++)
+        {
+            m_row_bufs[i] =
+                thd()->mem_root->ArrayAlloc<uchar>(m_table->s->rec_buff_length);
+            if (m_row_bufs[i] == nullptr) return true;
+            // Start out with the same contents (e.g. of hidden fields) as
+            // record[0].
+            memcpy(m_row_bufs[i], m_table->record[0], m_table->s->reclength);
+        }
+        if (m_use_normalized_keys)
+        {
+            m_row_keys = thd()->mem_root->ArrayAlloc<uchar*>(num_children);
+            m_output_key = thd()->mem_root->ArrayAlloc<uchar>(m_key_length);
+            if (m_row_keys == nullptr || m_output_key == nullptr) return true;
+            for (size_t i = 0; i < num_children; i++)
+            {
+                m_row_keys[i] = thd()->mem_root->ArrayAlloc<uchar>(m_key_length);
+                if (m_row_keys[i] == nullptr) return true;
+            }
+        }
+        m_blob_copies.resize((num_children + 1) * m_table->s->blob_fields);
+    }
+    std::fill_n(m_has_pending_row, num_children, false);
+    std::fill_n(m_child_eof, num_children, false);
+    m_copies_left = 0;
+    std::fill(m_child_stats.begin(), m_child_stats.end(),
+        SetOperationMergeChildStats());
+    m_num_comparisons = 0;
+    m_rows_returned = 0;
+    FindOutputRow();
+
+    // The children (e.g. their sorts) may read rows into the output row while
+    // being initialized; that is fine, as long as they deliver them to us
+    // through the fields.
+    for (size_t i = 0; i < num_children; i++)
     {
         if (m_sub_iterators[i]->Init())
             return true;
@@ -1698,143 +1812,1398 @@ bool IntersectIterator::Init()
     return false;
 }
 
-int IntersectIterator::Read() 
+int SetOperationMergeIterator::Read()
+{
+    const int err = ReadRow();
+    if (err == 0)
+        ++m_rows_returned;
+    else if (err == -1)
+        TraceExecution();
+    return err;
+}
+
+void SetOperationMergeIterator::TraceExecution() const
+{
+    Opt_trace_context* const trace = &thd()->opt_trace;
+    if (!trace->is_started()) return;
+    Opt_trace_object trace_wrapper(trace);
+    Opt_trace_object trace_exec(trace, "set_operation_execution");
+    trace_exec.add_alnum("operation", m_operation)
+        .add_alnum("algorithm", "merge")
+        .add("rows_returned", m_rows_returned)
+        .add("comparisons", m_num_comparisons);
+    Opt_trace_array trace_children(trace, "children");
+    for (const SetOperationMergeChildStats& stats : m_child_stats)
+    {
+        Opt_trace_object trace_child(trace);
+        trace_child.add("rows_read", stats.rows_read)
+            .add("seeks", stats.seeks)
+            .add("rows_skipped", stats.rows_skipped)
+            .add("rows_matched", stats.rows_matched);
+    }
+}
+
+void SetOperationMergeIterator::FindOutputRow()
+{
+    uchar* const row = m_table->field[0]->ptr - m_field_offset;
+    assert(m_copies_left == 0 || row == m_output_row);
+    m_output_row = row;
+    m_current_row = row;
+}
+
+void SetOperationMergeIterator::SwitchToRow(uchar* row)
+{
+    if (m_current_row == row) return;
+    repoint_field_to_record(m_table, m_current_row, row);
+    m_current_row = row;
+}
+
+int SetOperationMergeIterator::CompareRows(const uchar* row_a,
+    const uchar* row_b) const
+{
+    for (uint i = 0; i < m_table->visible_field_count(); i++)
+    {
+        Field* field = m_table->visible_field_ptr()[i];
+        if (field->is_nullable())
+        {
+            const size_t null_offset = field->null_offset(m_current_row);
+            const bool a_is_null = row_a[null_offset] & field->null_bit;
+            const bool b_is_null = row_b[null_offset] & field->null_bit;
+            if (a_is_null || b_is_null)
+            {
+                if (a_is_null && b_is_null) continue;
+                return a_is_null ? -1 : 1;
+            }
+        }
+        const ptrdiff_t offset = field->ptr - m_current_row;
+        const int cmp = field->cmp(row_a + offset, row_b + offset);
+        if (cmp != 0) return cmp;
+    }
+    return 0;
+}
+
+int SetOperationMergeIterator::ReadChild(size_t idx)
+{
+    SwitchToChildRow(idx);
+    m_has_pending_row[idx] = false;
+    int err = m_sub_iterators[idx]->Read();
+    if (err == -1) m_child_eof[idx] = true;
+    if (err == 0)
+    {
+        ++m_child_stats[idx].rows_read;
+        if (CopyBlobs(m_row_bufs[idx], ChildBlobCopies(idx))) return 1;
+        MakeChildKey(idx);
+    }
+    return err;
+}
+
+void SetOperationMergeIterator::MakeChildKey(size_t idx)
+{
+    // The fields point into the child's row buffer.
+    if (m_use_normalized_keys) MakeNormalizedKey(m_table, m_row_keys[idx]);
+}
+
+bool SetOperationMergeIterator::CopyBlobs(uchar* row, String* copies)
+{
+    const ptrdiff_t offset = row - m_current_row;
+    for (uint i = 0; i < m_table->s->blob_fields; i++)
+    {
+        Field_blob* field =
+            down_cast<Field_blob*>(m_table->field[m_table->s->blob_field[i]]);
+        field->move_field_offset(offset);
+        bool error = false;
+        if (!field->is_null())
+        {
+            const uint32 length = field->get_length();
+            const uchar* data = field->get_blob_data();
+            if (data != pointer_cast<const uchar*>(copies[i].ptr()))
+            {
+                error = copies[i].copy(pointer_cast<const char*>(data), length,
+                    &my_charset_bin);
+                if (!error)
+                    field->set_ptr(length,
+                        pointer_cast<const uchar*>(copies[i].ptr()));
+            }
+        }
+        field->move_field_offset(-offset);
+        if (error) return true;
+    }
+    return false;
+}
+
+bool SetOperationMergeIterator::CopyToOutputRow(size_t idx)
 {
-    KEY* key = m_table->key_info;
-    uchar **key_buf = new uchar*[m_sub_iterators.size()];
-    int err;
-    for (int i = 0; i < m_sub_iterators.size(); i++)
-        key_buf[i] = nullptr;
+    memcpy(m_output_row, m_row_bufs[idx], m_table->s->reclength);
+    if (m_use_normalized_keys)
+        memcpy(m_output_key, m_row_keys[idx], m_key_length);
+    // The child's copies of the BLOBs are overwritten by its next row, while
+    // the output row may be returned again and is compared to that row.
+    return CopyBlobs(m_output_row, OutputBlobCopies());
+}
 
-    int target = 0;
-    for (;;) 
+int SetOperationMergeIterator::CountRun(size_t idx, ha_rows* count)
+{
+    *count = 1;
+    for (;;)
     {
         if (thd()->killed) {  // Aborted by user.
             thd()->send_kill_message();
-            for (int i = 0; i < m_sub_iterators.size(); i++)
-                if(key_buf[i]!=nullptr)
-                    delete[] key_buf[i];
-            delete[] key_buf;
-
             return 1;
         }
 
+        int err = ReadChild(idx);
+        if (err == 1) return 1;  // Error.
+        if (err == -1) return 0;  // The run ended with the child.
+        if (CompareToOutputRow(idx) != 0)
         {
-            err = m_sub_iterators[0]->Read();
-            if (err != 0) {
-                // A row, or error.
-                for (int i = 0; i < m_sub_iterators.size(); i++)
-                    if (key_buf[i] != nullptr)
-                        delete[] key_buf[i];
-                delete[] key_buf;
+            // The first row of the next run; keep it for later.
+            m_has_pending_row[idx] = true;
+            return 0;
+        }
+        ++*count;
+    }
+}
 
-                return err;
+int SetOperationMergeIterator::SeekChild(size_t idx, uchar* target_row)
+{
+    const SeekInfo& seek = m_seek_info[idx];
+    assert(seek.table != nullptr);
+    m_has_pending_row[idx] = false;
+    KEY* index = &seek.table->key_info[seek.index];
+
+    // Build a lookup key from the target row. The planner has made sure that
+    // the leading key parts of the index are our columns, in the same order.
+    SwitchToRow(target_row);
+    const uint num_fields = m_table->visible_field_count();
+    uint num_key_parts = num_fields;
+    uint index_key_length = 0;
+    for (uint i = 0; i < num_fields; i++)
+    {
+        Field* from = m_table->visible_field_ptr()[i];
+        Field* to = index->key_part[i].field;
+        if (from->is_null())
+        {
+            if (!to->is_nullable())
+            {
+                // NULL sorts before every value the child can have here, so
+                // the row we want is the first one with the key parts before
+                // this one; seek on those only.
+                num_key_parts = i;
+                break;
             }
-             
-            key_buf[0] = new uchar[key->key_length];
-            key_copy(key_buf[0], m_table->record[0], key, key->key_length);
+            to->set_null();
         }
-
-        bool ok = true;
-        bool temp = false;
-        for (int i = 1; i < m_sub_iterators.size();) 
+        else
         {
-            if (thd()->killed) {  // Aborted by user.
-                thd()->send_kill_message();
-                for (int i = 0; i < m_sub_iterators.size(); i++)
-                    if (key_buf[i] != nullptr)
-                        delete[] key_buf[i];
-                delete[] key_buf;
+            to->set_notnull();
+            field_conv(to, from);
+        }
+        index_key_length += index->key_part[i].store_length;
+    }
+    // The current row of the child cannot be smaller than a row that starts
+    // with NULL in a column it cannot hold NULL in, but be safe.
+    if (num_key_parts == 0) return ReadChild(idx);
+    key_copy(m_seek_key_buf, seek.table->record[0], index, index_key_length);
+
+    // The handler is already positioned by the child's index scan, so reading
+    // the child after this continues from the row we find here.
+    ++m_child_stats[idx].seeks;
+    int error = seek.table->file->ha_index_read_map(
+        seek.table->record[0], m_seek_key_buf,
+        make_prev_keypart_map(num_key_parts), HA_READ_KEY_OR_NEXT);
+    if (error == HA_ERR_END_OF_FILE || error == HA_ERR_KEY_NOT_FOUND)
+    {
+        m_child_eof[idx] = true;
+        return -1;
+    }
+    if (error != 0)
+        return report_handler_error(seek.table, error);
 
-                return 1;
-            }
+    // Let the child's StreamingIterator do with the row what it does with
+    // the rows it reads.
+    SwitchToChildRow(idx);
+    if (seek.streaming_iterator->CopyCurrentRow())
+        return 1;
+    ++m_child_stats[idx].rows_read;
+    if (CopyBlobs(m_row_bufs[idx], ChildBlobCopies(idx))) return 1;
+    MakeChildKey(idx);
+    return 0;
+}
 
-            if(target == 0 || i > target || temp)
-            {
-                err = m_sub_iterators[i]->Read();
-                if (err != 0) {
-                    // A row, or error.
-                    for (int i = 0; i < m_sub_iterators.size(); i++)
-                        if (key_buf[i] != nullptr)
-                            delete[] key_buf[i];
-                    delete[] key_buf;
+void SetOperationMergeIterator::SetNullRowFlag(bool is_null_row) {
+    m_sub_iterators[0]->SetNullRowFlag(is_null_row);
+}
 
-                    return err;
-                }
+void SetOperationMergeIterator::StartPSIBatchMode() {
+    m_pfs_batch_mode_enabled = true;
+    for (const unique_ptr_destroy_only<RowIterator>& sub_iterator :
+        m_sub_iterators) {
+        sub_iterator->StartPSIBatchMode();
+    }
+}
+
+void SetOperationMergeIterator::EndPSIBatchModeIfStarted() {
+    for (const unique_ptr_destroy_only<RowIterator>& sub_iterator :
+        m_sub_iterators) {
+        sub_iterator->EndPSIBatchModeIfStarted();
+    }
+    m_pfs_batch_mode_enabled = false;
+}
+
+void SetOperationMergeIterator::UnlockRow() {
+    m_sub_iterators[0]->UnlockRow();
+}
+
+int IntersectIterator::ReadRow()
+{
+    FindOutputRow();
+    if (m_copies_left > 0)
+    {
+        // The row is still in the output row.
+        --m_copies_left;
+        return 0;
+    }
+
+    const size_t num_children = m_sub_iterators.size();
 
-                key_buf[i] = new uchar[key->key_length];
-                key_copy(key_buf[i], m_table->record[0], key, key->key_length);
+    // Whatever happens, leave the fields pointing at the output row for our
+    // parent.
+    auto switch_to_output_row =
+        create_scope_guard([this] { SwitchToOutputRow(); });
 
-                temp = false;
+    // Get a row from every child; the ones that counted a run the last time
+    // have the next one already.
+    size_t max_child = 0;
+    for (size_t i = 0; i < num_children; i++)
+    {
+        if (!m_has_pending_row[i])
+        {
+            // Nothing can match after the end of a child.
+            if (m_child_eof[i]) return -1;
+            int err = ReadChild(i);
+            if (err != 0) {
+                // EOF, or error.
+                return err;
             }
+        }
+        if (CompareChildRows(i, max_child) > 0)
+            max_child = i;
+    }
 
+    // Leapfrog: advance every child to the largest row seen so far, until all
+    // of them agree on it.
+    for (;;)
+    {
+        bool all_equal = true;
+        for (size_t i = 0; i < num_children; i++)
+        {
+            if (i == max_child) continue;
+            for (;;)
             {
-                int re = key_cmp2(key->key_part, key_buf[0], key->key_length, key_buf[i], key->key_length);
-                if (re == 0)
-                {
-                    // Same as previous row, so keep scanning.
-                    if(target == i)
-                        target = 0;
-
-                    i++;
+                if (thd()->killed) {  // Aborted by user.
+                    thd()->send_kill_message();
+                    return 1;
                 }
-                else if (re < 0) // Key1 before Key2
+
+                int re = CompareChildRows(i, max_child);
+                if (re == 0)
+                    break;
+                if (re > 0)
                 {
-                    ok = false;
-                    if(target == 0)
-                        target = i;
+                    // Child i skipped past the candidate; it becomes the new one.
+                    max_child = i;
+                    all_equal = false;
                     break;
                 }
+
+                // Child i is lagging behind; its row cannot match.
+                ++m_child_stats[i].rows_skipped;
+                int err;
+                if (m_seek_info[i].table != nullptr)
+                    err = SeekChild(i, m_row_bufs[max_child]);
                 else
-                {
-                    if (target == i)
-                        target = 0;
-                    else
-                        temp = true;
+                    err = ReadChild(i);
+                if (err != 0) {
+                    // EOF, or error.
+                    return err;
                 }
             }
+        }
+        if (all_equal) break;
+    }
+
+    // This is the only copy of the row we make.
+    if (CopyToOutputRow(max_child)) return 1;
+
+    // Skip the rest of the row in every child. INTERSECT ALL returns it as
+    // many times as the shortest run of it, INTERSECT DISTINCT once.
+    ha_rows min_count = HA_POS_ERROR;
+    for (size_t i = 0; i < num_children; i++)
+    {
+        ha_rows count;
+        if (CountRun(i, &count)) return 1;
+        m_child_stats[i].rows_matched += count;
+        min_count = std::min(min_count, count);
+    }
+    m_copies_left = m_distinct ? 0 : min_count - 1;
+    return 0;
+}
+
+ExceptIterator::ExceptIterator(
+    THD* thd, std::vector<unique_ptr_destroy_only<RowIterator>>&& sub_iterators,
+    TABLE* table, Mem_root_array<SeekInfo> seek_info,
+    Mem_root_array<bool> child_distinct)
+    : SetOperationMergeIterator(thd, move(sub_iterators), table,
+        std::move(seek_info), "except"),
+    m_child_distinct(std::move(child_distinct))
+{
+    assert(m_sub_iterators.size() >= 2);
+    assert(m_child_distinct.size() == m_sub_iterators.size());
+}
+
+int ExceptIterator::CountMatchingRun(size_t idx, ha_rows* count)
+{
+    *count = 0;
+    // A child can only seek once its scan has started.
+    bool can_seek = false;
+    for (;;)
+    {
+        if (!m_has_pending_row[idx])
+        {
+            if (m_child_eof[idx]) return 0;
+            int err;
+            if (can_seek && m_seek_info[idx].table != nullptr)
+                err = SeekChild(idx, m_output_row);
+            else
+                err = ReadChild(idx);
+            if (err == 1) return 1;  // Error.
+            if (err == -1) return 0;  // EOF.
+            m_has_pending_row[idx] = true;
+        }
+
+        const int cmp = CompareToOutputRow(idx);
+        if (cmp > 0) return 0;  // No match; keep the row for a later run.
+        if (cmp == 0)
+        {
+            if (CountRun(idx, count)) return 1;
+            m_child_stats[idx].rows_matched += *count;
+            return 0;
+        }
 
+        // Smaller than anything the first child has left, so skip it.
+        ++m_child_stats[idx].rows_skipped;
+        m_has_pending_row[idx] = false;
+        can_seek = true;
+
+        if (thd()->killed) {  // Aborted by user.
+            thd()->send_kill_message();
+            return 1;
         }
+    }
+}
 
-        if (ok)
+int ExceptIterator::ReadRow()
+{
+    FindOutputRow();
+    if (m_copies_left > 0)
+    {
+        // The row is still in the output row.
+        --m_copies_left;
+        return 0;
+    }
+
+    // Whatever happens, leave the fields pointing at the output row for our
+    // parent.
+    auto switch_to_output_row =
+        create_scope_guard([this] { SwitchToOutputRow(); });
+
+    for (;;)
+    {
+        // Take the next run of rows from the first child.
+        if (!m_has_pending_row[0])
+        {
+            if (m_child_eof[0]) return -1;
+            int err = ReadChild(0);
+            if (err != 0) {
+                // EOF, or error.
+                return err;
+            }
+        }
+        if (CopyToOutputRow(0)) return 1;
+        ha_rows count;
+        if (CountRun(0, &count)) return 1;
+        const ha_rows run_length = count;
+
+        // Subtract the other children from it, from left to right.
+        bool matched = false;
+        for (size_t i = 1; i < m_sub_iterators.size() && count > 0; i++)
         {
-            for (int i = 0; i < m_sub_iterators.size(); i++)
-                if (key_buf[i] != nullptr)
-                    delete[] key_buf[i];
-            delete[] key_buf;
+            ha_rows matches;
+            if (CountMatchingRun(i, &matches)) return 1;
+            matched |= matches > 0;
+            if (m_child_distinct[i])
+                count = matches == 0 ? 1 : 0;
+            else
+                count = count > matches ? count - matches : 0;
+        }
+        if (matched) m_child_stats[0].rows_matched += run_length;
 
+        if (count > 0)
+        {
+            m_copies_left = count - 1;
             return 0;
         }
+
+        if (thd()->killed) {  // Aborted by user.
+            thd()->send_kill_message();
+            return 1;
+        }
     }
+}
 
-    for (int i = 0; i < m_sub_iterators.size(); i++)
-        if (key_buf[i] != nullptr)
-            delete[] key_buf[i];
-    delete[] key_buf;
+bool CanUseNormalizedKeys(const TABLE* table) {
+    if (table->s->blob_fields != 0) return false;
+    for (uint i = 0; i < table->visible_field_count(); ++i) {
+        if (table->visible_field_ptr()[i]->sort_key_is_varlen()) return false;
+    }
+    return true;
+}
 
-    return -1;  
+static size_t NormalizedFieldLength(const Field* field) {
+    size_t length = field->sort_length();
+    if (field->result_type() == STRING_RESULT) {
+        const CHARSET_INFO* cs = field->sort_charset();
+        length = cs->coll->strnxfrmlen(cs, length);
+    }
+    return length;
 }
 
-void IntersectIterator::SetNullRowFlag(bool is_null_row) {
-    m_sub_iterators[0]->SetNullRowFlag(is_null_row);
+size_t NormalizedKeyLength(const TABLE* table) {
+    size_t length = 0;
+    for (uint i = 0; i < table->visible_field_count(); ++i) {
+        const Field* field = table->visible_field_ptr()[i];
+        if (field->is_nullable()) ++length;
+        length += NormalizedFieldLength(field);
+    }
+    return length;
 }
 
-void IntersectIterator::StartPSIBatchMode() {
-    m_pfs_batch_mode_enabled = true;
-    for (const unique_ptr_destroy_only<RowIterator>& sub_iterator :
-        m_sub_iterators) {
-        sub_iterator->StartPSIBatchMode();
+void MakeNormalizedKey(const TABLE* table, uchar* to) {
+    for (uint i = 0; i < table->visible_field_count(); ++i) {
+        const Field* field = table->visible_field_ptr()[i];
+        const size_t length = NormalizedFieldLength(field);
+        if (field->is_nullable()) {
+            if (field->is_null()) {
+                // All NULLs are equal to each other in set operations.
+                memset(to, 0, length + 1);
+                to += length + 1;
+                continue;
+            }
+            *to++ = 1;
+        }
+        const size_t written = field->make_sort_key(to, length);
+        // Sort keys for NO PAD collations are not padded; pad them with zeros
+        // so that the keys have fixed length.
+        if (written < length) memset(to + written, 0, length - written);
+        to += length;
     }
 }
 
-void IntersectIterator::EndPSIBatchModeIfStarted() {
-    for (const unique_ptr_destroy_only<RowIterator>& sub_iterator :
-        m_sub_iterators) {
-        sub_iterator->EndPSIBatchModeIfStarted();
+SetOperationSpill::~SetOperationSpill()
+{
+    for (size_t i = 0; i < kNumPartitions; ++i)
+    {
+        if (m_build_files[i].is_open) close_cached_file(&m_build_files[i].cache);
+        if (m_probe_files[i].is_open) close_cached_file(&m_probe_files[i].cache);
     }
-    m_pfs_batch_mode_enabled = false;
 }
 
-void IntersectIterator::UnlockRow() {
-    m_sub_iterators[0]->UnlockRow();
+size_t SetOperationSpill::Partition(const uchar* key) const
+{
+    // Use another seed than NormalizedKeyHasher, so that the keys of one
+    // partition still spread over the hash table they are loaded into.
+    return murmur3_32(key, m_key_length, /*seed=*/0x9e3779b9) % kNumPartitions;
+}
+
+bool SetOperationSpill::Reset()
+{
+    for (size_t i = 0; i < kNumPartitions; ++i)
+    {
+        for (File* file : { &m_build_files[i], &m_probe_files[i] })
+        {
+            if (!file->is_open) continue;
+            if (reinit_io_cache(&file->cache, WRITE_CACHE, 0, false, true))
+            {
+                my_error(ER_TEMP_FILE_WRITE_FAILURE, MYF(0));
+                return true;
+            }
+            file->num_records = 0;
+        }
+    }
+    return false;
+}
+
+bool SetOperationSpill::Write(File* file, const uchar* a, size_t a_length,
+    const uchar* b, size_t b_length)
+{
+    if (!file->is_open)
+    {
+        if (open_cached_file(&file->cache, mysql_tmpdir, TEMP_PREFIX,
+            DISK_BUFFER_SIZE, MYF(MY_WME)))
+        {
+            my_error(ER_TEMP_FILE_WRITE_FAILURE, MYF(0));
+            return true;
+        }
+        file->is_open = true;
+    }
+    if (my_b_write(&file->cache, a, a_length) ||
+        my_b_write(&file->cache, b, b_length))
+    {
+        my_error(ER_TEMP_FILE_WRITE_FAILURE, MYF(0));
+        return true;
+    }
+    ++file->num_records;
+    m_stats->bytes += a_length + b_length;
+    return false;
+}
+
+bool SetOperationSpill::WriteBuildKey(const uchar* key, uint64_t count)
+{
+    uchar count_buf[8];
+    int8store(count_buf, count);
+    ++m_stats->build_keys;
+    return Write(&m_build_files[Partition(key)], key, m_key_length, count_buf,
+        sizeof(count_buf));
+}
+
+bool SetOperationSpill::WriteProbeRow(const uchar* key, const uchar* row)
+{
+    ++m_stats->probe_rows;
+    return Write(&m_probe_files[Partition(key)], key, m_key_length, row,
+        m_row_length);
+}
+
+bool SetOperationSpill::StartReading(size_t partition)
+{
+    m_current_partition = partition;
+    for (File* file :
+        { &m_build_files[partition], &m_probe_files[partition] })
+    {
+        file->records_left = file->num_records;
+        if (file->is_open &&
+            reinit_io_cache(&file->cache, READ_CACHE, 0, false, false))
+        {
+            my_error(ER_TEMP_FILE_WRITE_FAILURE, MYF(0));
+            return true;
+        }
+    }
+    return false;
+}
+
+int SetOperationSpill::Read(File* file, uchar* a, size_t a_length, uchar* b,
+    size_t b_length)
+{
+    if (file->records_left == 0) return -1;
+    if (my_b_read(&file->cache, a, a_length) ||
+        my_b_read(&file->cache, b, b_length))
+    {
+        my_error(ER_TEMP_FILE_WRITE_FAILURE, MYF(0));
+        return 1;
+    }
+    --file->records_left;
+    return 0;
+}
+
+int SetOperationSpill::ReadBuildKey(uchar* key, uint64_t* count)
+{
+    uchar count_buf[8];
+    int err = Read(&m_build_files[m_current_partition], key, m_key_length,
+        count_buf, sizeof(count_buf));
+    if (err == 0) *count = uint8korr(count_buf);
+    return err;
+}
+
+int SetOperationSpill::ReadProbeRow(uchar* key, uchar* row)
+{
+    return Read(&m_probe_files[m_current_partition], key, m_key_length, row,
+        m_row_length);
+}
+
+/**
+  Writes what a hash-based set operation has read, returned and spilled to
+  disk to the optimizer trace: the first to the current object, the last as a
+  new object called “spill” in it.
+ */
+static void TraceHashStats(Opt_trace_context* trace, Opt_trace_object* obj,
+    const SetOperationHashStats& hash_stats,
+    const SetOperationSpillStats& stats)
+{
+    obj->add("build_rows", hash_stats.build_rows)
+        .add("probe_rows", hash_stats.probe_rows)
+        .add("rows_returned", hash_stats.rows_returned);
+    Opt_trace_object trace_spill(trace, "spill");
+    trace_spill.add("spills", stats.num_spills)
+        .add("build_keys", stats.build_keys)
+        .add("probe_rows", stats.probe_rows)
+        .add("bytes", stats.bytes);
+}
+
+HashIntersectIterator::HashIntersectIterator(
+    THD* thd, std::vector<unique_ptr_destroy_only<RowIterator>>&& sub_iterators,
+    TABLE* table)
+    : RowIterator(thd),
+    m_sub_iterators(move(sub_iterators)),
+    m_table(table),
+    m_field_offset(table->field[0]->ptr - table->record[0]),
+    m_mem_root(key_memory_hash_join, 16384 /* 16 kB */),
+    m_key_length(NormalizedKeyLength(table))
+{
+    assert(m_sub_iterators.size() >= 2);
+    assert(CanUseNormalizedKeys(table));
+}
+
+bool HashIntersectIterator::ResetHashTable()
+{
+    // Destroy the old hash table (if any) before we clear the memory it lives
+    // in.
+    m_hash_map.reset();
+    m_mem_root.ClearForReuse();
+    m_hash_map.reset(new (&m_mem_root)
+        mem_root_unordered_map<NormalizedKey, size_t, NormalizedKeyHasher>(
+            &m_mem_root));
+    return m_hash_map == nullptr;
+}
+
+bool HashIntersectIterator::Init()
+{
+    m_pfs_batch_mode_enabled = false;
+    if (m_key_buf == nullptr) {
+        m_key_buf = thd()->mem_root->ArrayAlloc<uchar>(m_key_length);
+        if (m_key_buf == nullptr) return true;
+    }
+
+    // We may be reinitialized, e.g. as part of a dependent subquery.
+    m_spilling = false;
+    m_stats = SetOperationHashStats();
+    m_spill_stats = SetOperationSpillStats();
+    if (ResetHashTable()) return true;
+
+    if (BuildHashTable()) return true;
+    if (!m_spilling) return m_sub_iterators.back()->Init();
+
+    if (SpillProbeRows()) return true;
+    m_partition = 0;
+    return LoadPartition(m_partition);
+}
+
+bool HashIntersectIterator::AddBuildKey(size_t idx)
+{
+    auto it = m_hash_map->find(CurrentKey());
+    if (idx == 0)
+    {
+        if (it != m_hash_map->end()) return false;  // Duplicate.
+        uchar* key = m_mem_root.ArrayAlloc<uchar>(m_key_length);
+        if (key == nullptr) return true;
+        memcpy(key, m_key_buf, m_key_length);
+        m_hash_map->emplace(NormalizedKey{ key, m_key_length }, 1);
+    }
+    else if (it != m_hash_map->end() && it->second == idx)
+    {
+        // Seen in all the children so far, including this one.
+        it->second = idx + 1;
+    }
+    return false;
+}
+
+bool HashIntersectIterator::StartSpilling(size_t idx)
+{
+    if (m_spill == nullptr)
+    {
+        m_spill.reset(new (thd()->mem_root) SetOperationSpill(
+            m_key_length, m_table->s->reclength, &m_spill_stats));
+        if (m_spill == nullptr) return true;
+    }
+    else if (m_spill->Reset())
+    {
+        return true;
+    }
+    m_spilling = true;
+    ++m_spill_stats.num_spills;
+
+    for (const auto& entry : *m_hash_map)
+    {
+        // Keys that are missing from one of the children before “idx” can
+        // never be returned.
+        if (entry.second < idx) continue;
+        if (m_spill->WriteBuildKey(entry.first.data,
+            kSpilledCount | entry.second))
+            return true;
+    }
+    return ResetHashTable();
+}
+
+bool HashIntersectIterator::BuildHashTable()
+{
+    const size_t max_memory = thd()->variables.join_buff_size;
+    for (size_t i = 0; i + 1 < m_sub_iterators.size(); ++i)
+    {
+        RowIterator* child = m_sub_iterators[i].get();
+        if (child->Init()) return true;
+
+        PFSBatchMode batch_mode(child);
+        for (;;)
+        {
+            int err = child->Read();
+            if (err == 1) return true;  // Error.
+            if (err == -1) break;       // EOF.
+
+            if (thd()->killed) {  // Aborted by user.
+                thd()->send_kill_message();
+                return true;
+            }
+
+            ++m_stats.build_rows;
+            MakeNormalizedKey(m_table, m_key_buf);
+            if (m_spilling)
+            {
+                if (m_spill->WriteBuildKey(m_key_buf, i)) return true;
+                continue;
+            }
+            if (AddBuildKey(i)) return true;
+            if (m_mem_root.allocated_size() > max_memory &&
+                StartSpilling(i))
+                return true;
+        }
+    }
+    return false;
+}
+
+bool HashIntersectIterator::SpillProbeRows()
+{
+    RowIterator* child = m_sub_iterators.back().get();
+    if (child->Init()) return true;
+
+    PFSBatchMode batch_mode(child);
+    for (;;)
+    {
+        int err = child->Read();
+        if (err == 1) return true;  // Error.
+        if (err == -1) return false;  // EOF.
+
+        if (thd()->killed) {  // Aborted by user.
+            thd()->send_kill_message();
+            return true;
+        }
+
+        ++m_stats.probe_rows;
+        MakeNormalizedKey(m_table, m_key_buf);
+        if (m_spill->WriteProbeRow(m_key_buf, CurrentRow())) return true;
+    }
+}
+
+bool HashIntersectIterator::LoadPartition(size_t partition)
+{
+    if (ResetHashTable() || m_spill->StartReading(partition)) return true;
+    for (;;)
+    {
+        uint64_t count;
+        int err = m_spill->ReadBuildKey(m_key_buf, &count);
+        if (err == 1) return true;
+        if (err == -1) return false;
+
+        if (count & kSpilledCount)
+        {
+            // Written before any other key of this partition, so it is new.
+            uchar* key = m_mem_root.ArrayAlloc<uchar>(m_key_length);
+            if (key == nullptr) return true;
+            memcpy(key, m_key_buf, m_key_length);
+            m_hash_map->emplace(NormalizedKey{ key, m_key_length },
+                count & ~kSpilledCount);
+        }
+        else if (AddBuildKey(count))
+        {
+            return true;
+        }
+    }
+}
+
+bool HashIntersectIterator::ProbeCurrentKey()
+{
+    const size_t last_child = m_sub_iterators.size() - 1;
+    auto it = m_hash_map->find(CurrentKey());
+    if (it == m_hash_map->end() || it->second != last_child)
+    {
+        // Missing from one of the other children, or already returned.
+        return false;
+    }
+    it->second = last_child + 1;
+    return true;
+}
+
+int HashIntersectIterator::Read()
+{
+    const int err = ReadRow();
+    if (err == 0)
+        ++m_stats.rows_returned;
+    else if (err == -1)
+        TraceExecution();
+    return err;
+}
+
+void HashIntersectIterator::TraceExecution() const
+{
+    Opt_trace_context* const trace = &thd()->opt_trace;
+    if (!trace->is_started()) return;
+    Opt_trace_object trace_wrapper(trace);
+    Opt_trace_object trace_exec(trace, "set_operation_execution");
+    trace_exec.add_alnum("operation", "intersect").add_alnum("algorithm", "hash");
+    TraceHashStats(trace, &trace_exec, m_stats, m_spill_stats);
+}
+
+int HashIntersectIterator::ReadRow()
+{
+    for (;;)
+    {
+        int err;
+        if (m_spilling)
+        {
+            err = m_spill->ReadProbeRow(m_key_buf, CurrentRow());
+            if (err == -1)
+            {
+                if (++m_partition == SetOperationSpill::kNumPartitions)
+                    return -1;
+                if (LoadPartition(m_partition)) return 1;
+                continue;
+            }
+        }
+        else
+        {
+            err = m_sub_iterators.back()->Read();
+        }
+        if (err != 0) {
+            // EOF, or error.
+            return err;
+        }
+
+        if (thd()->killed) {  // Aborted by user.
+            thd()->send_kill_message();
+            return 1;
+        }
+
+        if (!m_spilling)
+        {
+            ++m_stats.probe_rows;
+            MakeNormalizedKey(m_table, m_key_buf);
+        }
+        if (ProbeCurrentKey()) return 0;
+    }
+}
+
+void HashIntersectIterator::SetNullRowFlag(bool is_null_row) {
+    m_sub_iterators.back()->SetNullRowFlag(is_null_row);
+}
+
+void HashIntersectIterator::StartPSIBatchMode() {
+    m_pfs_batch_mode_enabled = true;
+    m_sub_iterators.back()->StartPSIBatchMode();
+}
+
+void HashIntersectIterator::EndPSIBatchModeIfStarted() {
+    for (const unique_ptr_destroy_only<RowIterator>& sub_iterator :
+        m_sub_iterators) {
+        sub_iterator->EndPSIBatchModeIfStarted();
+    }
+    m_pfs_batch_mode_enabled = false;
+}
+
+void HashIntersectIterator::UnlockRow() {
+    m_sub_iterators.back()->UnlockRow();
+}
+
+HashExceptIterator::HashExceptIterator(
+    THD* thd, std::vector<unique_ptr_destroy_only<RowIterator>>&& sub_iterators,
+    TABLE* table, bool distinct)
+    : RowIterator(thd),
+    m_sub_iterators(move(sub_iterators)),
+    m_table(table),
+    m_distinct(distinct),
+    m_field_offset(table->field[0]->ptr - table->record[0]),
+    m_mem_root(key_memory_hash_join, 16384 /* 16 kB */),
+    m_key_length(NormalizedKeyLength(table))
+{
+    assert(m_sub_iterators.size() >= 2);
+    assert(CanUseNormalizedKeys(table));
+}
+
+bool HashExceptIterator::ResetHashTable()
+{
+    // Destroy the old hash table (if any) before we clear the memory it lives
+    // in.
+    m_hash_map.reset();
+    m_mem_root.ClearForReuse();
+    m_hash_map.reset(new (&m_mem_root)
+        mem_root_unordered_map<NormalizedKey, size_t, NormalizedKeyHasher>(
+            &m_mem_root));
+    return m_hash_map == nullptr;
+}
+
+bool HashExceptIterator::Init()
+{
+    m_pfs_batch_mode_enabled = false;
+    if (m_key_buf == nullptr) {
+        m_key_buf = thd()->mem_root->ArrayAlloc<uchar>(m_key_length);
+        if (m_key_buf == nullptr) return true;
+    }
+
+    // We may be reinitialized, e.g. as part of a dependent subquery.
+    m_spilling = false;
+    m_stats = SetOperationHashStats();
+    m_spill_stats = SetOperationSpillStats();
+    if (ResetHashTable()) return true;
+
+    if (BuildHashTable()) return true;
+    if (!m_spilling) return m_sub_iterators[0]->Init();
+
+    if (SpillProbeRows()) return true;
+    m_partition = 0;
+    return LoadPartition(m_partition);
+}
+
+bool HashExceptIterator::InsertCurrentKey(size_t count)
+{
+    uchar* key = m_mem_root.ArrayAlloc<uchar>(m_key_length);
+    if (key == nullptr) return true;
+    memcpy(key, m_key_buf, m_key_length);
+    m_hash_map->emplace(NormalizedKey{ key, m_key_length }, count);
+    return false;
+}
+
+bool HashExceptIterator::AddBuildKey(size_t count)
+{
+    auto it = m_hash_map->find(CurrentKey());
+    if (it != m_hash_map->end())
+    {
+        it->second += count;
+        return false;
+    }
+    return InsertCurrentKey(count);
+}
+
+bool HashExceptIterator::StartSpilling()
+{
+    if (m_spill == nullptr)
+    {
+        m_spill.reset(new (thd()->mem_root) SetOperationSpill(
+            m_key_length, m_table->s->reclength, &m_spill_stats));
+        if (m_spill == nullptr) return true;
+    }
+    else if (m_spill->Reset())
+    {
+        return true;
+    }
+    m_spilling = true;
+    ++m_spill_stats.num_spills;
+
+    for (const auto& entry : *m_hash_map)
+    {
+        if (m_spill->WriteBuildKey(entry.first.data, entry.second)) return true;
+    }
+    return ResetHashTable();
+}
+
+bool HashExceptIterator::BuildHashTable()
+{
+    const size_t max_memory = thd()->variables.join_buff_size;
+    for (size_t i = 1; i < m_sub_iterators.size(); ++i)
+    {
+        RowIterator* child = m_sub_iterators[i].get();
+        if (child->Init()) return true;
+
+        PFSBatchMode batch_mode(child);
+        for (;;)
+        {
+            int err = child->Read();
+            if (err == 1) return true;  // Error.
+            if (err == -1) break;       // EOF.
+
+            if (thd()->killed) {  // Aborted by user.
+                thd()->send_kill_message();
+                return true;
+            }
+
+            ++m_stats.build_rows;
+            MakeNormalizedKey(m_table, m_key_buf);
+            if (m_spilling)
+            {
+                if (m_spill->WriteBuildKey(m_key_buf, 1)) return true;
+                continue;
+            }
+            if (AddBuildKey(1)) return true;
+            if (m_mem_root.allocated_size() > max_memory && StartSpilling())
+                return true;
+        }
+    }
+    return false;
+}
+
+bool HashExceptIterator::SpillProbeRows()
+{
+    RowIterator* child = m_sub_iterators[0].get();
+    if (child->Init()) return true;
+
+    PFSBatchMode batch_mode(child);
+    for (;;)
+    {
+        int err = child->Read();
+        if (err == 1) return true;  // Error.
+        if (err == -1) return false;  // EOF.
+
+        if (thd()->killed) {  // Aborted by user.
+            thd()->send_kill_message();
+            return true;
+        }
+
+        ++m_stats.probe_rows;
+        MakeNormalizedKey(m_table, m_key_buf);
+        if (m_spill->WriteProbeRow(m_key_buf, CurrentRow())) return true;
+    }
+}
+
+bool HashExceptIterator::LoadPartition(size_t partition)
+{
+    if (ResetHashTable() || m_spill->StartReading(partition)) return true;
+    for (;;)
+    {
+        uint64_t count;
+        int err = m_spill->ReadBuildKey(m_key_buf, &count);
+        if (err == 1) return true;
+        if (err == -1) return false;
+        if (AddBuildKey(count)) return true;
+    }
+}
+
+bool HashExceptIterator::ProbeCurrentKey(bool* error)
+{
+    auto it = m_hash_map->find(CurrentKey());
+    if (m_distinct)
+    {
+        // Present in one of the other children, or already returned.
+        if (it != m_hash_map->end()) return false;
+        *error = InsertCurrentKey(0);
+        return true;
+    }
+    if (it != m_hash_map->end() && it->second > 0)
+    {
+        // Cancelled out by a copy in one of the other children.
+        --it->second;
+        return false;
+    }
+    return true;
+}
+
+int HashExceptIterator::Read()
+{
+    const int err = ReadRow();
+    if (err == 0)
+        ++m_stats.rows_returned;
+    else if (err == -1)
+        TraceExecution();
+    return err;
+}
+
+void HashExceptIterator::TraceExecution() const
+{
+    Opt_trace_context* const trace = &thd()->opt_trace;
+    if (!trace->is_started()) return;
+    Opt_trace_object trace_wrapper(trace);
+    Opt_trace_object trace_exec(trace, "set_operation_execution");
+    trace_exec.add_alnum("operation", "except").add_alnum("algorithm", "hash");
+    TraceHashStats(trace, &trace_exec, m_stats, m_spill_stats);
+}
+
+int HashExceptIterator::ReadRow()
+{
+    for (;;)
+    {
+        int err;
+        if (m_spilling)
+        {
+            err = m_spill->ReadProbeRow(m_key_buf, CurrentRow());
+            if (err == -1)
+            {
+                if (++m_partition == SetOperationSpill::kNumPartitions)
+                    return -1;
+                if (LoadPartition(m_partition)) return 1;
+                continue;
+            }
+        }
+        else
+        {
+            err = m_sub_iterators[0]->Read();
+        }
+        if (err != 0) {
+            // EOF, or error.
+            return err;
+        }
+
+        if (thd()->killed) {  // Aborted by user.
+            thd()->send_kill_message();
+            return 1;
+        }
+
+        if (!m_spilling)
+        {
+            ++m_stats.probe_rows;
+            MakeNormalizedKey(m_table, m_key_buf);
+        }
+        bool error = false;
+        const bool found = ProbeCurrentKey(&error);
+        if (error) return 1;
+        if (found) return 0;
+    }
+}
+
+void HashExceptIterator::SetNullRowFlag(bool is_null_row) {
+    m_sub_iterators[0]->SetNullRowFlag(is_null_row);
+}
+
+void HashExceptIterator::StartPSIBatchMode() {
+    m_pfs_batch_mode_enabled = true;
+    m_sub_iterators[0]->StartPSIBatchMode();
+}
+
+void HashExceptIterator::EndPSIBatchModeIfStarted() {
+    for (const unique_ptr_destroy_only<RowIterator>& sub_iterator :
+        m_sub_iterators) {
+        sub_iterator->EndPSIBatchModeIfStarted();
+    }
+    m_pfs_batch_mode_enabled = false;
+}
+
+void HashExceptIterator::UnlockRow() {
+    m_sub_iterators[0]->UnlockRow();
+}
+
+SetOperationBloomFilter::SetOperationBloomFilter(double expected_keys)
+    : m_expected_keys(expected_keys),
+    m_num_words(std::max<size_t>(
+        1, (static_cast<size_t>(expected_keys) * kBitsPerKey + 63) / 64)) {}
+
+bool SetOperationBloomFilter::Clear(MEM_ROOT* mem_root)
+{
+    if (m_bits == nullptr) {
+        m_bits = mem_root->ArrayAlloc<uint64_t>(m_num_words);
+        if (m_bits == nullptr) return true;
+    }
+    std::fill_n(m_bits, m_num_words, 0);
+    return false;
+}
+
+// The probes are derived from one hash by double hashing, as in LevelDB.
+void SetOperationBloomFilter::Add(uint32 hash)
+{
+    const size_t num_bits = m_num_words * 64;
+    const uint32 delta = (hash >> 17) | (hash << 15);
+    for (int i = 0; i < kNumHashes; ++i) {
+        const size_t bit = hash % num_bits;
+        m_bits[bit / 64] |= uint64_t{ 1 } << (bit % 64);
+        hash += delta;
+    }
+}
+
+bool SetOperationBloomFilter::MayContain(uint32 hash) const
+{
+    const size_t num_bits = m_num_words * 64;
+    const uint32 delta = (hash >> 17) | (hash << 15);
+    for (int i = 0; i < kNumHashes; ++i) {
+        const size_t bit = hash % num_bits;
+        if ((m_bits[bit / 64] & (uint64_t{ 1 } << (bit % 64))) == 0) {
+            return false;
+        }
+        hash += delta;
+    }
+    return true;
+}
+
+BloomFilterIterator::BloomFilterIterator(
+    THD* thd, unique_ptr_destroy_only<RowIterator> source, TABLE* table,
+    SetOperationBloomFilter* filter, bool build)
+    : RowIterator(thd),
+    m_source(move(source)),
+    m_table(table),
+    m_filter(filter),
+    m_build(build),
+    m_key_length(NormalizedKeyLength(table))
+{
+    assert(CanUseNormalizedKeys(table));
+}
+
+bool BloomFilterIterator::Init()
+{
+    if (m_key_buf == nullptr) {
+        m_key_buf = thd()->mem_root->ArrayAlloc<uchar>(m_key_length);
+        if (m_key_buf == nullptr) return true;
+    }
+    // We may be reinitialized, e.g. as part of a dependent subquery; the
+    // filter must then only hold the rows of this execution.
+    if (m_build && m_filter->Clear(thd()->mem_root)) return true;
+    return m_source->Init();
+}
+
+uint32 BloomFilterIterator::CurrentHash()
+{
+    MakeNormalizedKey(m_table, m_key_buf);
+    return murmur3_32(m_key_buf, m_key_length, /*seed=*/0);
+}
+
+int BloomFilterIterator::Read()
+{
+    for (;;)
+    {
+        int err = m_source->Read();
+        if (err != 0) {
+            // EOF, or error.
+            return err;
+        }
+
+        if (m_build) {
+            m_filter->Add(CurrentHash());
+            return 0;
+        }
+
+        if (thd()->killed) {  // Aborted by user.
+            thd()->send_kill_message();
+            return 1;
+        }
+
+        if (m_filter->MayContain(CurrentHash())) return 0;
+    }
+}
+
+IntersectSemiJoinIterator::IntersectSemiJoinIterator(
+    THD* thd, unique_ptr_destroy_only<RowIterator> source, TABLE* table,
+    TABLE* lookup_table, uint lookup_index, Item* condition)
+    : RowIterator(thd),
+    m_source(move(source)),
+    m_table(table),
+    m_lookup_table(lookup_table),
+    m_lookup_index(lookup_index),
+    m_condition(condition) {}
+
+IntersectSemiJoinIterator::~IntersectSemiJoinIterator()
+{
+    if (m_lookup_table->file != nullptr &&
+        m_lookup_table->file->inited == handler::INDEX)
+        m_lookup_table->file->ha_index_end();
+}
+
+bool IntersectSemiJoinIterator::Init()
+{
+    if (m_key_buf == nullptr) {
+        const KEY& index = m_lookup_table->key_info[m_lookup_index];
+        for (uint i = 0; i < m_table->visible_field_count(); ++i)
+            m_key_length += index.key_part[i].store_length;
+        m_key_buf = thd()->mem_root->ArrayAlloc<uchar>(m_key_length);
+        if (m_key_buf == nullptr) return true;
+    }
+    // Start a fresh index scan on every Init(), in case an earlier execution
+    // (or anything else) left a scan open, possibly on a different index.
+    handler* file = m_lookup_table->file;
+    file->ha_index_or_rnd_end();
+    int error = file->ha_index_init(m_lookup_index, /*sorted=*/false);
+    if (error) {
+        file->print_error(error, MYF(0));
+        return true;
+    }
+    m_rows_read = 0;
+    m_lookups = 0;
+    m_rows_returned = 0;
+    return m_source->Init();
+}
+
+int IntersectSemiJoinIterator::Lookup()
+{
+    const KEY* index = &m_lookup_table->key_info[m_lookup_index];
+    const uint num_fields = m_table->visible_field_count();
+    for (uint i = 0; i < num_fields; i++)
+    {
+        Field* from = m_table->visible_field_ptr()[i];
+        Field* to = index->key_part[i].field;
+        if (from->is_null())
+        {
+            // Nothing to find in a column that cannot hold NULL.
+            if (!to->is_nullable()) return -1;
+            to->set_null();
+        }
+        else
+        {
+            to->set_notnull();
+            field_conv(to, from);
+        }
+    }
+    key_copy(m_key_buf, m_lookup_table->record[0], index, m_key_length);
+
+    handler* file = m_lookup_table->file;
+    ++m_lookups;
+    int error = file->ha_index_read_map(m_lookup_table->record[0], m_key_buf,
+        make_prev_keypart_map(num_fields), HA_READ_KEY_EXACT);
+    for (;;)
+    {
+        if (error == HA_ERR_END_OF_FILE || error == HA_ERR_KEY_NOT_FOUND)
+            return -1;
+        if (error != 0)
+            return report_handler_error(m_lookup_table, error);
+
+        if (m_condition == nullptr) return 0;
+        const bool matched = m_condition->val_int() != 0;
+        if (thd()->is_error()) return 1;
+        if (matched) return 0;
+
+        error = file->ha_index_next_same(m_lookup_table->record[0], m_key_buf,
+            m_key_length);
+    }
+}
+
+int IntersectSemiJoinIterator::Read()
+{
+    const int err = ReadRow();
+    if (err == 0)
+        ++m_rows_returned;
+    else if (err == -1)
+        TraceExecution();
+    return err;
+}
+
+void IntersectSemiJoinIterator::TraceExecution() const
+{
+    Opt_trace_context* const trace = &thd()->opt_trace;
+    if (!trace->is_started()) return;
+    Opt_trace_object trace_wrapper(trace);
+    Opt_trace_object trace_exec(trace, "set_operation_execution");
+    trace_exec.add_alnum("operation", "intersect")
+        .add_alnum("algorithm", "semijoin")
+        .add("rows_read", m_rows_read)
+        .add("lookups", m_lookups)
+        .add("rows_returned", m_rows_returned);
+}
+
+int IntersectSemiJoinIterator::ReadRow()
+{
+    for (;;)
+    {
+        int err = m_source->Read();
+        if (err != 0) {
+            // EOF, or error.
+            return err;
+        }
+        ++m_rows_read;
+
+        if (thd()->killed) {  // Aborted by user.
+            thd()->send_kill_message();
+            return 1;
+        }
+
+        err = Lookup();
+        if (err != -1) return err;
+    }
 }
@@ -36,6 +36,8 @@
 #include "sql/table.h"
 #include "sql/timing_iterator.h"
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 using pack_rows::TableCollection;
@@ -67,6 +69,243 @@ AccessPath *NewSortAccessPath(THD *thd, AccessPath *child, Filesort *filesort,
   return path;
 }
 
+// Costs for the set operations, in the same unit as the other costs of the
+// old optimizer (where evaluating a row is 0.1). Sorting is per row and per
+// merge pass.
+static constexpr double kSetOpSortOneRowCost = 0.01;
+static constexpr double kSetOpCompareOneRowCost = 0.01;
+static constexpr double kSetOpHashOneRowCost = 0.05;
+
+static double SetOperationSortCost(double rows) {
+    return kSetOpSortOneRowCost * rows * std::max(std::log2(rows), 1.0);
+}
+
+/**
+  Sets the estimates for the Filesort of a child of a set operation, unless it
+  has them already. Duplicate removal is not taken into account.
+ */
+static void EstimateSetOperationSortCost(AccessPath* path) {
+    if (path->type != AccessPath::SORT || path->cost >= 0.0) return;
+    const AccessPath* child = path->sort().child;
+    if (child->num_output_rows < 0.0 || child->cost < 0.0) return;
+
+    const double rows = child->num_output_rows;
+    const double sort_cost = SetOperationSortCost(rows);
+    path->num_output_rows = rows;
+    // All rows need to be sorted before the first one can be returned.
+    path->init_cost = child->cost + sort_cost;
+    path->cost = path->init_cost;
+}
+
+/// How a merged set operation reads one of its children.
+struct MergedChildEstimate {
+    double rows;
+    double cost;
+    double init_cost;
+};
+
+/**
+  Estimates how a merged set operation reads the given child, whose own
+  estimates must be known. A child that is neither ordered nor sorted has not
+  been given its sort yet, because the merge is only being costed against
+  other plans; it is charged for the sort all the same. A child that the merge
+  can seek in is read with one index lookup for each of “seek_rows” rows (the
+  rows of the other children that it is advanced to), if that is cheaper than
+  reading it in full. Pass -1.0 if the child is never sought in.
+ */
+static MergedChildEstimate EstimateMergedChild(
+    const IntersectPathParameters& child, double seek_rows) {
+    const AccessPath* path = child.path;
+    MergedChildEstimate estimate{path->num_output_rows, path->cost,
+                                 std::max(path->init_cost, 0.0)};
+    if (!child.is_ordered && path->type != AccessPath::SORT) {
+        estimate.cost += SetOperationSortCost(estimate.rows);
+        estimate.init_cost = estimate.cost;
+    }
+    if (child.seek_table != nullptr && seek_rows >= 0.0 &&
+        seek_rows < estimate.rows) {
+        const double lookup_cost =
+            child.seek_table->file
+                ->read_cost(child.seek_index, /*ranges=*/1.0, /*rows=*/1.0)
+                .total_cost();
+        if (seek_rows * lookup_cost < estimate.cost) {
+            estimate.rows = seek_rows;
+            estimate.cost = seek_rows * lookup_cost;
+        }
+    }
+    return estimate;
+}
+
+void EstimateIntersectCost(AccessPath* path) {
+    const auto& param = path->intersect();
+    // The two smallest children; a child is sought to the rows of the
+    // smallest of the others.
+    double min_rows = -1.0;
+    double second_min_rows = -1.0;
+    for (const IntersectPathParameters& child : *param.children) {
+        EstimateSetOperationSortCost(child.path);
+        if (child.path->num_output_rows < 0.0 || child.path->cost < 0.0)
+            return;
+
+        const double rows = child.path->num_output_rows;
+        if (min_rows < 0.0 || rows < min_rows) {
+            second_min_rows = min_rows;
+            min_rows = rows;
+        } else if (second_min_rows < 0.0 || rows < second_min_rows) {
+            second_min_rows = rows;
+        }
+    }
+
+    double total_rows = 0.0;
+    double cost = 0.0;
+    double init_cost = 0.0;
+    for (size_t i = 0; i < param.children->size(); ++i) {
+        const IntersectPathParameters& child = (*param.children)[i];
+        if (!param.use_hash) {
+            const MergedChildEstimate estimate = EstimateMergedChild(
+                child, child.path->num_output_rows == min_rows
+                           ? second_min_rows
+                           : min_rows);
+            total_rows += estimate.rows;
+            cost += estimate.cost;
+            init_cost += estimate.init_cost;
+            continue;
+        }
+
+        const double rows = child.path->num_output_rows;
+        total_rows += rows;
+        cost += child.path->cost;
+
+        const bool is_last = i == param.children->size() - 1;
+        if (!is_last) {
+            // All children but the last are read up-front, to build and
+            // filter the hash table.
+            init_cost += child.path->cost + kSetOpHashOneRowCost * rows;
+        } else {
+            init_cost += std::max(child.path->init_cost, 0.0);
+        }
+    }
+
+    // Assume that the values of the smaller children are contained in the
+    // larger ones, so the output is as large as the smallest child.
+    path->num_output_rows = min_rows;
+    path->cost = cost + (param.use_hash ? kSetOpHashOneRowCost
+                                        : kSetOpCompareOneRowCost) *
+                            total_rows;
+    path->init_cost = init_cost;
+}
+
+void EstimateExceptCost(AccessPath* path) {
+    const auto& param = path->except();
+    for (const IntersectPathParameters& child : *param.children) {
+        EstimateSetOperationSortCost(child.path);
+        if (child.path->num_output_rows < 0.0 || child.path->cost < 0.0)
+            return;
+    }
+
+    double total_rows = 0.0;
+    double cost = 0.0;
+    double init_cost = 0.0;
+    for (size_t i = 0; i < param.children->size(); ++i) {
+        const IntersectPathParameters& child = (*param.children)[i];
+        if (!param.use_hash) {
+            // The other children are sought to the rows of the first one.
+            const MergedChildEstimate estimate = EstimateMergedChild(
+                child, i == 0 ? -1.0
+                              : (*param.children)[0].path->num_output_rows);
+            total_rows += estimate.rows;
+            cost += estimate.cost;
+            init_cost += estimate.init_cost;
+            continue;
+        }
+
+        const double rows = child.path->num_output_rows;
+        total_rows += rows;
+        cost += child.path->cost;
+
+        if (i > 0) {
+            // All children but the first are read up-front, to build the
+            // hash table.
+            init_cost += child.path->cost + kSetOpHashOneRowCost * rows;
+        } else {
+            init_cost += std::max(child.path->init_cost, 0.0);
+        }
+    }
+
+    // We know nothing about the overlap, so assume that little of the first
+    // child is removed.
+    path->num_output_rows = (*param.children)[0].path->num_output_rows;
+    path->cost = cost + (param.use_hash ? kSetOpHashOneRowCost
+                                        : kSetOpCompareOneRowCost) *
+                            total_rows;
+    path->init_cost = init_cost;
+}
+
+void EstimateAppendCost(AccessPath* path) {
+    const Mem_root_array<AppendPathParameters>& children =
+        *path->append().children;
+    double rows = 0.0;
+    double cost = 0.0;
+    for (const AppendPathParameters& child : children) {
+        EstimateSetOperationSortCost(child.path);
+        if (child.path->num_output_rows < 0.0 || child.path->cost < 0.0)
+            return;
+        rows += child.path->num_output_rows;
+        cost += child.path->cost;
+    }
+
+    path->num_output_rows = rows;
+    path->cost = cost;
+    // The children are read one after the other.
+    path->init_cost = std::max(children[0].path->init_cost, 0.0);
+}
+
+/// The rows expected to get through a Bloom filter built from “build_rows”
+/// rows, out of “probe_rows”.
+static double BloomFilterOutputRows(double build_rows, double probe_rows) {
+    const double matching_rows = std::min(build_rows, probe_rows);
+    return matching_rows + SetOperationBloomFilter::kFalsePositiveRate *
+                               (probe_rows - matching_rows);
+}
+
+void EstimateBloomFilterCost(AccessPath* path) {
+    const auto& param = path->bloom_filter();
+    const AccessPath* child = param.child;
+    if (child->num_output_rows < 0.0 || child->cost < 0.0) return;
+
+    const double rows = child->num_output_rows;
+    path->num_output_rows =
+        param.build ? rows
+                    : BloomFilterOutputRows(param.filter->expected_keys(), rows);
+    path->cost = child->cost + kSetOpHashOneRowCost * rows;
+    path->init_cost = std::max(child->init_cost, 0.0);
+}
+
+void EstimateIntersectSemiJoinCost(AccessPath* path) {
+    const auto& param = path->intersect_semijoin();
+    AccessPath* outer = param.outer->path;
+    EstimateSetOperationSortCost(outer);
+    if (outer->num_output_rows < 0.0 || outer->cost < 0.0) return;
+
+    // Assume that every row is found, as for the estimates of INTERSECT.
+    const double rows = outer->num_output_rows;
+    const double lookup_cost =
+        param.lookup_table->file
+            ->read_cost(param.lookup_index, /*ranges=*/1.0, /*rows=*/1.0)
+            .total_cost();
+    path->num_output_rows = rows;
+    path->cost = outer->cost + rows * lookup_cost;
+    path->init_cost = std::max(outer->init_cost, 0.0);
+}
+
+bool IsBloomFilterWorthwhile(double build_rows, double probe_rows) {
+    if (build_rows < 0.0 || probe_rows <= build_rows) return false;
+    const double saved_cost =
+        SetOperationSortCost(probe_rows) -
+        SetOperationSortCost(BloomFilterOutputRows(build_rows, probe_rows));
+    return saved_cost > kSetOpHashOneRowCost * (build_rows + probe_rows);
+}
+
 static AccessPath *FindSingleAccessPathOfType(AccessPath *path,
                                               AccessPath::Type type) {
   AccessPath *found_path = nullptr;
@@ -203,6 +442,19 @@ table_map GetUsedTables(const AccessPath *path) {
         }
         return used_tables;
     }
+    case AccessPath::EXCEPT: {
+        table_map used_tables = 0;
+        for (const IntersectPathParameters& child : *path->except().children) {
+            used_tables |= GetUsedTables(child.path);
+        }
+        return used_tables;
+    }
+    case AccessPath::BLOOM_FILTER:
+        return GetUsedTables(path->bloom_filter().child);
+    case AccessPath::INTERSECT_SEMIJOIN:
+        return GetUsedTables(path->intersect_semijoin().outer->path) |
+            path->intersect_semijoin()
+                .lookup_table->pos_in_table_list->map();
     case AccessPath::WINDOWING:
       return GetUsedTables(path->windowing().child);
     case AccessPath::WEEDOUT:
@@ -287,6 +539,24 @@ static TableCollection GetUsedTablesForAggregate(JOIN *join,
   return tables;
 }
 
+/**
+  Tells a merge-based set operation how it can seek in the given child, if at
+  all. The child's iterator must have been created.
+ */
+static SetOperationMergeIterator::SeekInfo GetSetOperationSeekInfo(
+    const IntersectPathParameters& child) {
+  SetOperationMergeIterator::SeekInfo seek;
+  if (child.seek_table != nullptr) {
+    // A child that can seek is the query block's stream, unsorted.
+    assert(child.path->type == AccessPath::STREAM);
+    seek.table = child.seek_table;
+    seek.index = child.seek_index;
+    seek.streaming_iterator =
+        down_cast<StreamingIterator *>(child.path->iterator->real_iterator());
+  }
+  return seek;
+}
+
 unique_ptr_destroy_only<RowIterator> CreateIteratorFromAccessPath(
     THD *thd, AccessPath *path, JOIN *join, bool eligible_for_batch_mode) {
   unique_ptr_destroy_only<RowIterator> iterator;
@@ -606,6 +876,10 @@ unique_ptr_destroy_only<RowIterator> CreateIteratorFromAccessPath(
         to.copy_fields_and_items = from.copy_fields_and_items;
         to.temp_table_param = from.temp_table_param;
         to.is_recursive_reference = from.is_recursive_reference;
+        to.use_bulk_insert = path->materialize().bulk_insert;
+        if (from.subquery_path->num_output_rows >= 0.0)
+          to.expected_rows =
+              static_cast<ha_rows>(from.subquery_path->num_output_rows);
 
         if (to.is_recursive_reference) {
           // Find the recursive reference to ourselves; there should be
@@ -668,12 +942,59 @@ unique_ptr_destroy_only<RowIterator> CreateIteratorFromAccessPath(
         const auto& param = path->intersect();
         vector<unique_ptr_destroy_only<RowIterator>> children;
         children.reserve(param.children->size());
+        Mem_root_array<SetOperationMergeIterator::SeekInfo> seek_info(thd->mem_root);
         for (const IntersectPathParameters& child : *param.children) 
         {
             children.push_back(CreateIteratorFromAccessPath(
                 thd, child.path, child.join, /*eligible_for_batch_mode=*/true));
+            seek_info.push_back(GetSetOperationSeekInfo(child));
+        }
+        if (param.use_hash) {
+            iterator = NewIterator<HashIntersectIterator>(thd, move(children), param.table);
+        } else {
+            iterator = NewIterator<IntersectIterator>(thd, move(children), param.table,
+                std::move(seek_info), param.distinct);
+        }
+        break;
+    }
+    case AccessPath::EXCEPT: {
+        const auto& param = path->except();
+        vector<unique_ptr_destroy_only<RowIterator>> children;
+        children.reserve(param.children->size());
+        Mem_root_array<SetOperationMergeIterator::SeekInfo> seek_info(thd->mem_root);
+        Mem_root_array<bool> child_distinct(thd->mem_root);
+        for (const IntersectPathParameters& child : *param.children)
+        {
+            children.push_back(CreateIteratorFromAccessPath(
+                thd, child.path, child.join, /*eligible_for_batch_mode=*/true));
+            seek_info.push_back(GetSetOperationSeekInfo(child));
+            child_distinct.push_back(child.is_distinct);
+        }
+        if (param.use_hash) {
+            iterator = NewIterator<HashExceptIterator>(thd, move(children),
+                param.table, param.distinct);
+        } else {
+            iterator = NewIterator<ExceptIterator>(thd, move(children), param.table,
+                std::move(seek_info), std::move(child_distinct));
         }
-        iterator = NewIterator<IntersectIterator>(thd, move(children), param.table);
+        break;
+    }
+    case AccessPath::BLOOM_FILTER: {
+        const auto& param = path->bloom_filter();
+        unique_ptr_destroy_only<RowIterator> child = CreateIteratorFromAccessPath(
+            thd, param.child, join, eligible_for_batch_mode);
+        iterator = NewIterator<BloomFilterIterator>(thd, move(child),
+            param.table, param.filter, param.build);
+        break;
+    }
+    case AccessPath::INTERSECT_SEMIJOIN: {
+        const auto& param = path->intersect_semijoin();
+        unique_ptr_destroy_only<RowIterator> outer = CreateIteratorFromAccessPath(
+            thd, param.outer->path, param.outer->join,
+            /*eligible_for_batch_mode=*/true);
+        iterator = NewIterator<IntersectSemiJoinIterator>(thd, move(outer),
+            param.table, param.lookup_table, param.lookup_index,
+            param.condition);
         break;
     }
     case AccessPath::WINDOWING: {
@@ -45,6 +45,7 @@ class RowIterator;
 class QEP_TAB;
 class QUICK_SELECT_I;
 class SJ_TMP_TABLE;
+class SetOperationBloomFilter;
 class Table_function;
 class Temp_table_param;
 struct AccessPath;
@@ -131,9 +132,26 @@ struct AppendPathParameters {
   JOIN *join;
 };
 
+// Also used for the children of EXCEPT, and for the operands of a UNION that
+// is mixed with INTERSECT or EXCEPT.
 struct IntersectPathParameters {
     AccessPath* path;
+    // nullptr if the child is a nested set operation, in a query expression
+    // that mixes them.
     JOIN* join;
+    // True if the child already delivers its rows in merge order (ascending on
+    // all columns), so that it was not given a sort. Shown in the optimizer
+    // trace as its negation, "sorted" (see TraceSetOperationChildren()).
+    bool is_ordered = false;
+    // If the child is an ascending scan of an index whose leading columns are
+    // the child's select list, the table and index being scanned. The child
+    // then delivers rows in merge order without a sort, and the merge can skip
+    // ahead in it with index lookups. nullptr otherwise.
+    TABLE* seek_table = nullptr;
+    uint seek_index = 0;
+    // For EXCEPT and UNION: true if the operator to the left of the child is
+    // DISTINCT (as opposed to ALL). Unused for the first child.
+    bool is_distinct = false;
 };
 
 /**
@@ -203,7 +221,10 @@ struct AccessPath {
     REMOVE_DUPLICATES,
     ALTERNATIVE,
     CACHE_INVALIDATOR,
-    INTERSECT
+    INTERSECT,
+    EXCEPT,
+    BLOOM_FILTER,
+    INTERSECT_SEMIJOIN
   } type;
 
   /// Whether this access path counts as one that scans a base table,
@@ -532,6 +553,30 @@ struct AccessPath {
       assert(type == INTERSECT);
       return u.intersect;
   }
+  auto& except() {
+      assert(type == EXCEPT);
+      return u.except;
+  }
+  const auto& except() const {
+      assert(type == EXCEPT);
+      return u.except;
+  }
+  auto& bloom_filter() {
+      assert(type == BLOOM_FILTER);
+      return u.bloom_filter;
+  }
+  const auto& bloom_filter() const {
+      assert(type == BLOOM_FILTER);
+      return u.bloom_filter;
+  }
+  auto& intersect_semijoin() {
+      assert(type == INTERSECT_SEMIJOIN);
+      return u.intersect_semijoin;
+  }
+  const auto& intersect_semijoin() const {
+      assert(type == INTERSECT_SEMIJOIN);
+      return u.intersect_semijoin;
+  }
   auto &windowing() {
     assert(type == WINDOWING);
     return u.windowing;
@@ -739,6 +784,11 @@ struct AccessPath {
       // Large, and has nontrivial destructors, so split out
       // into its own allocation.
       MaterializePathParameters *param;
+
+      // Whether the rows may be written in bulk (see
+      // MaterializeIterator::QueryBlock::use_bulk_insert). Set only for the
+      // result table of a set operation.
+      bool bulk_insert;
     } materialize;
     struct {
       AccessPath *table_path;
@@ -751,7 +801,46 @@ struct AccessPath {
     struct {
         Mem_root_array<IntersectPathParameters>* children;
         TABLE* table;
+        // If true, use HashIntersectIterator instead of merging sorted
+        // children; the first child is the one that gets hashed.
+        bool use_hash;
+        // True for INTERSECT DISTINCT. The merge then removes duplicates
+        // itself, so the children need not be free of them.
+        bool distinct;
     } intersect;
+    struct {
+        // The first child is the left-hand side; the others are subtracted
+        // from it in order.
+        Mem_root_array<IntersectPathParameters>* children;
+        TABLE* table;
+        // If true, use HashExceptIterator instead of merging sorted children;
+        // all children but the first one get hashed.
+        bool use_hash;
+        // For HashExceptIterator: true if all the operators are
+        // EXCEPT DISTINCT, false if all are EXCEPT ALL.
+        bool distinct;
+    } except;
+    struct {
+        AccessPath* child;
+        SetOperationBloomFilter* filter;
+        // The set operation's table, which the child writes its rows into.
+        TABLE* table;
+        // True if the child's rows are added to the filter, false if they
+        // are dropped unless found in it.
+        bool build;
+    } bloom_filter;
+    struct {
+        // The other operands, intersected and free of duplicates.
+        IntersectPathParameters* outer;
+        // The set operation's table, which “outer” writes its rows into.
+        TABLE* table;
+        // The table the looked-up operand would have scanned, and the index
+        // whose leading columns are the operand's select list.
+        TABLE* lookup_table;
+        // The operand's WHERE condition, or nullptr.
+        Item* condition;
+        uint lookup_index;
+    } intersect_semijoin;
     struct {
       AccessPath *child;
       Temp_table_param *temp_table_param;
@@ -1166,6 +1255,7 @@ inline AccessPath *NewMaterializeAccessPath(
   path->type = AccessPath::MATERIALIZE;
   path->materialize().table_path = table_path;
   path->materialize().param = param;
+  path->materialize().bulk_insert = false;
   return path;
 }
 
@@ -1190,14 +1280,109 @@ inline AccessPath *NewAppendAccessPath(
 }
 
 inline AccessPath* NewIntersectAccessPath(
-    THD* thd, Mem_root_array<IntersectPathParameters>* children, TABLE* table) {
+    THD* thd, Mem_root_array<IntersectPathParameters>* children, TABLE* table,
+    bool use_hash, bool distinct) {
     AccessPath* path = new (thd->mem_root) AccessPath;
     path->type = AccessPath::INTERSECT;
     path->intersect().children = children;
     path->intersect().table = table;
+    path->intersect().use_hash = use_hash;
+    path->intersect().distinct = distinct;
     return path;
 }
 
+/**
+  Sets the row and cost estimates of an INTERSECT access path (and of the
+  sorts of its children, if they do not have any yet) from the estimates of
+  its children. Leaves them unknown if any child's estimates are unknown.
+
+  A merged INTERSECT can be costed before its children are given their sorts,
+  so that it can be compared to other plans without being built: a child that
+  is neither ordered nor sorted is charged for a sort. Children that the merge
+  can seek in are charged for the index lookups instead of a full read, if
+  that is cheaper.
+ */
+void EstimateIntersectCost(AccessPath* path);
+
+inline AccessPath* NewExceptAccessPath(
+    THD* thd, Mem_root_array<IntersectPathParameters>* children, TABLE* table,
+    bool use_hash, bool distinct) {
+    AccessPath* path = new (thd->mem_root) AccessPath;
+    path->type = AccessPath::EXCEPT;
+    path->except().children = children;
+    path->except().table = table;
+    path->except().use_hash = use_hash;
+    path->except().distinct = distinct;
+    return path;
+}
+
+/**
+  Sets the row and cost estimates of an EXCEPT access path (and of the sorts
+  of its children, if they do not have any yet) from the estimates of its
+  children. Leaves them unknown if any child's estimates are unknown. A merged
+  EXCEPT can be costed before its children are sorted, like an INTERSECT; see
+  EstimateIntersectCost().
+ */
+void EstimateExceptCost(AccessPath* path);
+
+inline AccessPath* NewBloomFilterAccessPath(
+    THD* thd, AccessPath* child, SetOperationBloomFilter* filter, TABLE* table,
+    bool build) {
+    AccessPath* path = new (thd->mem_root) AccessPath;
+    path->type = AccessPath::BLOOM_FILTER;
+    path->bloom_filter().child = child;
+    path->bloom_filter().filter = filter;
+    path->bloom_filter().table = table;
+    path->bloom_filter().build = build;
+    return path;
+}
+
+/**
+  Sets the row and cost estimates of a BLOOM_FILTER access path from those of
+  its child. A probing filter is assumed to let through as many rows as it was
+  built from (see EstimateIntersectCost()), plus the false positives among the
+  rest. Leaves them unknown if the child's estimates are unknown.
+ */
+void EstimateBloomFilterCost(AccessPath* path);
+
+/**
+  Returns true if filtering the rows of a child of a merged INTERSECT through
+  a Bloom filter over the rows of another child is estimated to save more on
+  sorting the former than it costs to hash the rows of both.
+
+  @param build_rows Estimated rows of the child the filter is built from.
+  @param probe_rows Estimated rows of the child that would be filtered.
+ */
+bool IsBloomFilterWorthwhile(double build_rows, double probe_rows);
+
+inline AccessPath* NewIntersectSemiJoinAccessPath(
+    THD* thd, IntersectPathParameters* outer, TABLE* table,
+    TABLE* lookup_table, uint lookup_index, Item* condition) {
+    AccessPath* path = new (thd->mem_root) AccessPath;
+    path->type = AccessPath::INTERSECT_SEMIJOIN;
+    path->intersect_semijoin().outer = outer;
+    path->intersect_semijoin().table = table;
+    path->intersect_semijoin().lookup_table = lookup_table;
+    path->intersect_semijoin().lookup_index = lookup_index;
+    path->intersect_semijoin().condition = condition;
+    return path;
+}
+
+/**
+  Sets the row and cost estimates of an INTERSECT_SEMIJOIN access path (and of
+  the sort of its outer operand, if it does not have any yet) from those of
+  its outer operand and the handler's cost of an index lookup.
+  Leaves them unknown if the outer operand's estimates are unknown.
+ */
+void EstimateIntersectSemiJoinCost(AccessPath* path);
+
+/**
+  Sets the row and cost estimates of an APPEND access path (and of the sorts
+  of its children, if they do not have any yet) from the estimates of its
+  children. Leaves them unknown if any child's estimates are unknown.
+ */
+void EstimateAppendCost(AccessPath* path);
+
 inline AccessPath *NewWindowingAccessPath(THD *thd, AccessPath *child,
                                           Temp_table_param *temp_table_param,
                                           int ref_slice, bool needs_buffering) {
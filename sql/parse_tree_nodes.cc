@@ -626,7 +626,7 @@ Sql_cmd *PT_select_stmt::make_cmd(THD *thd) {
     // Example: ... INTO ... FOR UPDATE;
     push_warning(thd, ER_WARN_DEPRECATED_INNER_INTO);
   } else if (has_into_clause_inside_query_block && 
-      (thd->lex->unit->is_union()|| thd->lex->unit->is_intersect())) {
+      (thd->lex->unit->is_union()|| thd->lex->unit->is_intersect_or_except())) {
     // Example: ... UNION ... INTO ...;
     if (!m_qe->has_trailing_into_clause()) {
       // Example: ... UNION SELECT * INTO OUTFILE 'foo' FROM ...;
@@ -1305,14 +1305,71 @@ bool PT_table_factor_joined_table::contextualize(Parse_context *pc) {
   return false;
 }
 
+/**
+  The query blocks of a query expression form a flat list, in which INTERSECT
+  binds tighter than UNION and EXCEPT. A parenthesized operand can only be
+  flattened into it if none of its operators bind looser than the operators
+  around it.
+
+  @returns true if a query block after “first” is joined to the one before it
+    by UNION or EXCEPT
+*/
+static bool has_union_or_except_after(const Query_block *first) {
+  for (const Query_block *sl = first->next_query_block(); sl != nullptr;
+       sl = sl->next_query_block()) {
+    if (sl->linkage != INTERSECT_TYPE) return true;
+  }
+  return false;
+}
+
+/// @returns true if the query expression of “query_block” has ORDER BY or
+/// LIMIT of its own, i.e., outside of its query blocks
+static bool has_global_order_or_limit(const Query_block *query_block) {
+  const Query_block *fake =
+      query_block->master_query_expression()->fake_query_block;
+  return fake != nullptr && (fake->is_ordered() || fake->has_limit());
+}
+
+/**
+  Checks that a parenthesized right-hand side of a set operation can be
+  flattened into the query expression, which its query blocks have been added
+  to, starting with “rhs_first”. If the parentheses also hold an ORDER BY or
+  LIMIT for a set operation, it would have gone to the query expression as a
+  whole.
+
+  @param rhs_first                  The first query block of the right-hand
+                                    side
+  @param had_global_order_or_limit  has_global_order_or_limit() before the
+                                    right-hand side was contextualized
+
+  @returns true on error
+*/
+static bool check_parenthesized_rhs(const Query_block *rhs_first,
+                                    bool had_global_order_or_limit) {
+  if (has_union_or_except_after(rhs_first)) {
+    my_error(ER_NOT_SUPPORTED_YET, MYF(0),
+             "UNION or EXCEPT in a parenthesized right-hand side");
+    return true;
+  }
+  if (!had_global_order_or_limit && has_global_order_or_limit(rhs_first)) {
+    my_error(ER_NOT_SUPPORTED_YET, MYF(0),
+             "ORDER BY or LIMIT for a parenthesized right-hand side");
+    return true;
+  }
+  return false;
+}
+
 bool PT_union::contextualize(Parse_context *pc) {
   if (PT_query_expression_body::contextualize(pc)) return true;
 
   if (m_lhs->contextualize(pc)) return true;
 
   pc->select = pc->thd->lex->new_union_query(pc->select, m_is_distinct);
+  if (pc->select == nullptr) return true;
+  Query_block *const rhs_first = pc->select;
+  const bool had_global_order_or_limit = has_global_order_or_limit(rhs_first);
 
-  if (pc->select == nullptr || m_rhs->contextualize(pc)) return true;
+  if (m_rhs->contextualize(pc)) return true;
 
   if (m_rhs->is_union()) {
     my_error(ER_NOT_SUPPORTED_YET, MYF(0),
@@ -1320,6 +1377,10 @@ bool PT_union::contextualize(Parse_context *pc) {
     return true;
   }
 
+  if (m_is_rhs_in_parentheses &&
+      check_parenthesized_rhs(rhs_first, had_global_order_or_limit))
+    return true;
+
   pc->thd->lex->pop_context();
   return false;
 }
@@ -1329,16 +1390,57 @@ bool PT_intersect::contextualize(Parse_context* pc) {
 
     if (m_lhs->contextualize(pc)) return true;
 
+    // Without the parentheses, INTERSECT would bind to the last operand of
+    // the left-hand side only.
+    if (m_is_lhs_in_parentheses &&
+        has_union_or_except_after(
+            pc->select->master_query_expression()->first_query_block())) {
+        my_error(ER_NOT_SUPPORTED_YET, MYF(0),
+            "UNION or EXCEPT in a parenthesized left-hand side of INTERSECT");
+        return true;
+    }
+
     pc->select = pc->thd->lex->new_intersect_query(pc->select, m_is_distinct);
+    if (pc->select == nullptr) return true;
+    Query_block* const rhs_first = pc->select;
+    const bool had_global_order_or_limit = has_global_order_or_limit(rhs_first);
+
+    // A nested INTERSECT on the right-hand side is flattened into this one,
+    // which is correct since INTERSECT is associative: a row is returned if
+    // it is in all operands, as many times as the fewest copies of it in any
+    // of them, or once if any of the operators is DISTINCT.
+    if (m_rhs->contextualize(pc)) return true;
+
+    if (m_is_rhs_in_parentheses &&
+        check_parenthesized_rhs(rhs_first, had_global_order_or_limit))
+        return true;
 
-    if (pc->select == nullptr || m_rhs->contextualize(pc)) return true;
+    pc->thd->lex->pop_context();
+    return false;
+}
+
+bool PT_except::contextualize(Parse_context* pc) {
+    if (PT_query_expression_body::contextualize(pc)) return true;
+
+    if (m_lhs->contextualize(pc)) return true;
 
-    if (m_rhs->is_intersect()) {
+    pc->select = pc->thd->lex->new_except_query(pc->select, m_is_distinct);
+    if (pc->select == nullptr) return true;
+    Query_block* const rhs_first = pc->select;
+    const bool had_global_order_or_limit = has_global_order_or_limit(rhs_first);
+
+    if (m_rhs->contextualize(pc)) return true;
+
+    if (m_rhs->is_except()) {
         my_error(ER_NOT_SUPPORTED_YET, MYF(0),
-            "nesting of intersects at the right-hand side");
+            "nesting of excepts at the right-hand side");
         return true;
     }
 
+    if (m_is_rhs_in_parentheses &&
+        check_parenthesized_rhs(rhs_first, had_global_order_or_limit))
+        return true;
+
     pc->thd->lex->pop_context();
     return false;
 }
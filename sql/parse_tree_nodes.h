@@ -728,6 +728,7 @@ class PT_query_expression_body : public Parse_tree_node {
  public:
   virtual bool is_union() const = 0;
   virtual bool is_intersect() const = 0;
+  virtual bool is_except() const = 0;
   /**
     True if this query expression can absorb an extraneous order by/limit
     clause. The `ORDER BY`/`LIMIT` syntax is mostly consistestent, i.e. a
@@ -1449,6 +1450,7 @@ class PT_query_specification : public PT_query_primary {
 
   bool is_union() const override { return false; }
   bool is_intersect() const override { return false; }
+  bool is_except() const override { return false; }
 
   bool can_absorb_order_and_limit(bool, bool) const override { return true; }
 
@@ -1475,6 +1477,7 @@ class PT_table_value_constructor : public PT_query_primary {
 
   bool is_union() const override { return false; }
   bool is_intersect() const override { return false; }
+  bool is_except() const override { return false; }
 
   bool can_absorb_order_and_limit(bool, bool) const override { return true; }
 
@@ -1516,6 +1519,7 @@ class PT_query_expression final : public PT_query_primary {
 
   bool is_union() const override { return m_body->is_union(); }
   bool is_intersect() const override { return m_body->is_intersect(); }
+  bool is_except() const override { return m_body->is_except(); }
 
   bool has_into_clause() const override { return m_body->has_into_clause(); }
   bool has_trailing_into_clause() const override {
@@ -1524,7 +1528,7 @@ class PT_query_expression final : public PT_query_primary {
   }
 
   bool can_absorb_order_and_limit(bool order, bool limit) const override {
-    if (m_body->is_union()|| m_body->is_intersect()) {
+    if (m_body->is_union()|| m_body->is_intersect() || m_body->is_except()) {
       return false;
     }
     if (m_order == nullptr && m_limit == nullptr) {
@@ -1608,6 +1612,7 @@ class PT_locking final : public PT_query_primary {
 
   bool is_union() const override { return m_query_expression->is_union(); }
   bool is_intersect() const override { return m_query_expression->is_intersect(); }
+  bool is_except() const override { return m_query_expression->is_except(); }
 
   bool has_into_clause() const override {
     return m_query_expression->has_into_clause();
@@ -1666,6 +1671,7 @@ class PT_union : public PT_query_expression_body {
 
   bool is_union() const override { return true; }
   bool is_intersect() const override { return false; }
+  bool is_except() const override { return false; }
 
   bool has_into_clause() const override {
     return m_lhs->has_into_clause() || m_rhs->has_into_clause();
@@ -1691,6 +1697,46 @@ class PT_union : public PT_query_expression_body {
 class PT_intersect : public PT_query_expression_body {
 public:
     PT_intersect(PT_query_expression_body* lhs, const POS& lhs_pos, bool is_distinct,
+        PT_query_primary* rhs, bool is_rhs_in_parentheses = false,
+        bool is_lhs_in_parentheses = false)
+        : m_lhs(lhs),
+        m_lhs_pos(lhs_pos),
+        m_is_distinct(is_distinct),
+        m_rhs(rhs),
+        m_is_rhs_in_parentheses{ is_rhs_in_parentheses },
+        m_is_lhs_in_parentheses{ is_lhs_in_parentheses } {}
+
+    bool contextualize(Parse_context* pc) override;
+
+    bool is_union() const override { return false; }  
+    bool is_intersect() const override { return true; }
+    bool is_except() const override { return false; }
+
+    bool has_into_clause() const override {
+        return m_lhs->has_into_clause() || m_rhs->has_into_clause();
+    }
+    bool has_trailing_into_clause() const override {
+        return !m_is_rhs_in_parentheses && m_rhs->has_trailing_into_clause();
+    }
+
+    bool can_absorb_order_and_limit(bool, bool) const override { return false; }
+
+    bool is_table_value_constructor() const override { return false; }
+    PT_insert_values_list* get_row_value_list() const override { return nullptr; }
+
+private:
+    PT_query_expression_body* m_lhs;
+    POS m_lhs_pos;
+    bool m_is_distinct;
+    PT_query_primary* m_rhs;
+    PT_into_destination* m_into;
+    const bool m_is_rhs_in_parentheses;
+    const bool m_is_lhs_in_parentheses;
+};
+
+class PT_except : public PT_query_expression_body {
+public:
+    PT_except(PT_query_expression_body* lhs, const POS& lhs_pos, bool is_distinct,
         PT_query_primary* rhs, bool is_rhs_in_parentheses = false)
         : m_lhs(lhs),
         m_lhs_pos(lhs_pos),
@@ -1701,7 +1747,8 @@ public:
     bool contextualize(Parse_context* pc) override;
 
     bool is_union() const override { return false; }  
-    bool is_intersect() const override { return true; }
+    bool is_intersect() const override { return false; }
+    bool is_except() const override { return true; }
 
     bool has_into_clause() const override {
         return m_lhs->has_into_clause() || m_rhs->has_into_clause();
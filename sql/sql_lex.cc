@@ -675,7 +675,7 @@ Query_block *LEX::new_query(Query_block *curr_query_block) {
   } else if ((parsing_place == CTX_INSERT_VALUES) ||
              (parsing_place == CTX_INSERT_UPDATE &&
              (curr_query_block->master_query_expression()->is_union() || 
-              curr_query_block->master_query_expression()->is_intersect())
+              curr_query_block->master_query_expression()->is_intersect_or_except())
              )) {
     /*
       Outer references are not allowed for
@@ -746,6 +746,7 @@ Query_block *LEX::new_union_query(Query_block *curr_query_block,
   select->include_in_global(&all_query_blocks_list);
 
   select->linkage = UNION_TYPE;
+  select->set_operation_distinct = distinct;
 
   if (distinct) /* UNION DISTINCT - remember position */
     sel_query_expression->union_distinct = select;
@@ -796,6 +797,7 @@ Query_block* LEX::new_intersect_query(Query_block* curr_query_block,
     select->include_in_global(&all_query_blocks_list);
 
     select->linkage = INTERSECT_TYPE;
+    select->set_operation_distinct = distinct;
 
     if (distinct) /* UNION DISTINCT - remember position */
         sel_query_expression->intersect_distinct = select;
@@ -809,6 +811,64 @@ Query_block* LEX::new_intersect_query(Query_block* curr_query_block,
     return select;
 }
 
+/**
+  Create new query_block object for all branches of an EXCEPT except the
+  left-most one, like new_union_query().
+
+  @param curr_query_block current query specification
+  @param distinct True if part of EXCEPT DISTINCT query
+
+  @return new query specification if successful, NULL if an error occurred.
+*/
+
+Query_block* LEX::new_except_query(Query_block* curr_query_block,
+    bool distinct) {
+    DBUG_TRACE;
+
+    assert(unit != nullptr && query_block != nullptr);
+
+    // Is this the outer-most query expression?
+    bool const outer_most = curr_query_block->master_query_expression() == unit;
+    /*
+       Only the last SELECT can have INTO. Since the grammar won't allow INTO in
+       a nested SELECT, we make this check only when creating a query block on
+       the outer-most level:
+    */
+    if (outer_most && result) {
+        my_error(ER_MISPLACED_INTO, MYF(0));
+        return nullptr;
+    }
+
+    Query_block* const select = new_empty_query_block();
+    if (!select) return nullptr; /* purecov: inspected */
+
+    select->include_neighbour(this, curr_query_block);
+
+    Query_expression* const sel_query_expression =
+        select->master_query_expression();
+
+    if (!sel_query_expression->fake_query_block &&
+        sel_query_expression->add_fake_query_block(thd))
+        return nullptr; /* purecov: inspected */
+
+    if (select->set_context(
+        sel_query_expression->first_query_block()->context.outer_context))
+        return nullptr; /* purecov: inspected */
+
+    select->include_in_global(&all_query_blocks_list);
+
+    select->linkage = EXCEPT_TYPE;
+    select->set_operation_distinct = distinct;
+
+    /*
+      By default we assume that this is a regular subquery, in which resolution
+      of names in SELECT list is allowed.
+    */
+    select->context.resolve_in_select_list = true;
+
+    return select;
+}
+
 /**
   Given a LEX object, create a query expression object
   (query_block_query_expression) and a query block object (query_block).
@@ -2617,31 +2677,22 @@ bool Query_block::setup_base_ref_items(THD *thd) {
 void Query_expression::print(const THD *thd, String *str,
                              enum_query_type query_type) {
   if (m_with_clause) m_with_clause->print(thd, str, query_type);
-  bool union_all = !union_distinct;
-  bool intersect_all = !intersect_distinct;
   for (Query_block *sl = first_query_block(); sl; sl = sl->next_query_block()) {
     if (sl != first_query_block()) {
-        if (is_union())
-        {
-            str->append(STRING_WITH_LEN(" union "));
-            if (union_all)
-                str->append(STRING_WITH_LEN("all "));
-            else if (union_distinct == sl)
-                union_all = true;
-        }
-        else if (is_intersect())
-        {
+        // Each query block has the operator to its left, so that query
+        // expressions mixing them come out the way they were written.
+        if (sl->linkage == INTERSECT_TYPE)
             str->append(STRING_WITH_LEN(" intersect "));
-            if (intersect_all)
-                str->append(STRING_WITH_LEN("all "));
-            else if (intersect_distinct == sl)
-                intersect_all = true;
-        }
-
+        else if (sl->linkage == EXCEPT_TYPE)
+            str->append(STRING_WITH_LEN(" except "));
+        else
+            str->append(STRING_WITH_LEN(" union "));
+        if (!sl->set_operation_distinct)
+            str->append(STRING_WITH_LEN("all "));
     }
     bool parentheses_are_needed =
         (sl->has_limit() || sl->is_ordered()) &&
-        (is_union() || is_intersect() ||
+        (is_union() || is_intersect_or_except() ||
          (fake_query_block != nullptr &&
           (fake_query_block->has_limit() || fake_query_block->is_ordered())));
     if (parentheses_are_needed) str->append('(');
@@ -3817,8 +3868,7 @@ bool Query_expression::union_needs_tmp_table(LEX *lex) {
 }
 
 bool Query_expression::intersect_needs_tmp_table(LEX* lex) {
-    return intersect_distinct != nullptr ||
-        global_parameters()->order_list.elements != 0 ||
+    return global_parameters()->order_list.elements != 0 ||
         ((lex->sql_command == SQLCOM_INSERT_SELECT ||
             lex->sql_command == SQLCOM_REPLACE_SELECT) &&
             lex->unit == this);
@@ -3855,7 +3905,7 @@ void Query_expression::include_down(LEX *lex, Query_block *outer) {
 */
 
 bool Query_expression::is_mergeable() const {
-  if (is_union() || is_intersect()) return false;
+  if (is_union() || is_intersect_or_except()) return false;
 
   Query_block *const select = first_query_block();
   return !select->is_grouped() && !select->having_cond() &&
@@ -4384,17 +4434,19 @@ enum_explain_type Query_block::type() {
   } 
   else
   {
-      if (master_query_expression()->is_union())
+      // The operator to the left of this query block; they can differ if
+      // the query expression mixes them.
+      if (linkage == INTERSECT_TYPE)
       {
-          return enum_explain_type::EXPLAIN_UNION;
+          return enum_explain_type::EXPLAIN_INTERSECT;
       }
-      else if (master_query_expression()->is_intersect())
+      else if (linkage == EXCEPT_TYPE)
       {
-          return enum_explain_type::EXPLAIN_INTERSECT;
+          return enum_explain_type::EXPLAIN_EXCEPT;
       }
       else
       {
-          return enum_explain_type::EXPLAIN_EXCEPT;
+          return enum_explain_type::EXPLAIN_UNION;
       }
   }
     
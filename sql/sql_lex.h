@@ -97,6 +97,7 @@
 class Alter_info;
 class Event_parse_data;
 class Field;
+class Filesort;
 class Item_cond;
 class Item_func_get_system_var;
 class Item_func_match;
@@ -660,6 +661,7 @@ class Query_expression {
   TABLE_LIST result_table_list{};
   Query_result_union *union_result;
 
+  /// The result of an INTERSECT or EXCEPT.
   Query_result_intersect* intersect_result;
   /// Temporary table using for appending UNION results.
   /// Not used if we materialize directly into a parent query expression's
@@ -716,7 +718,7 @@ class Query_expression {
   explicit Query_expression(enum_parsing_context parsing_context);
 
   /// @return true for a query expression without UNION or multi-level ORDER
-  bool is_simple() const { return !(is_union() || is_intersect() || fake_query_block); }
+  bool is_simple() const { return !(is_union() || is_intersect_or_except() || fake_query_block); }
 
   /// Values for Query_expression::cleaned
   enum enum_clean_state {
@@ -730,6 +732,21 @@ class Query_expression {
 
   // list of (visible) fields which points to temporary table for union
   mem_root_deque<Item *> item_list;
+  /**
+    For INTERSECT and EXCEPT: ascending order on all of item_list, in which
+    the operands are sorted for merging. Made once, when item_list is.
+  */
+  ORDER *m_set_operation_order{nullptr};
+  /**
+    For INTERSECT and EXCEPT: the Filesorts on m_set_operation_order that
+    sort the operands of the set operations (and the UNION DISTINCT mixed
+    with them), indexed by whether they remove duplicates. Made on the
+    statement MEM_ROOT by the first plan that needs them, and handed out
+    again to the plans of later executions of a prepared statement.
+  */
+  Mem_root_array<Filesort *> *m_set_operation_sorts[2]{nullptr, nullptr};
+  /// The table that m_set_operation_sorts sort.
+  TABLE *m_set_operation_sorts_table{nullptr};
 
  private:
   /*
@@ -996,10 +1013,19 @@ class Query_expression {
   bool mixed_union_operators() const;
 
   inline bool is_intersect() const;
+  /// @returns true if INTERSECT/EXCEPT rows must be materialized before they
+  /// can be sent on (ORDER BY, or the top unit of INSERT ... SELECT)
   bool intersect_needs_tmp_table(LEX* lex);
   /// @returns true if mixes UNION DISTINCT and UNION ALL
   bool mixed_intersect_operators() const;
 
+  inline bool is_except() const;
+  /// @returns true if any of the set operations is INTERSECT or EXCEPT. Such
+  /// query expressions, including those that mix them with UNION, share
+  /// intersect_result and are executed by merging or hashing their query
+  /// blocks.
+  bool is_intersect_or_except() const;
+
   /// Include a query expression below a query block.
   void include_down(LEX *lex, Query_block *outer);
 
@@ -2075,6 +2101,15 @@ class Query_block {
   /// Describes context of this query block (e.g if it is a derived table).
   sub_select_type linkage{UNSPECIFIED_TYPE};
 
+  /**
+    For a query block that is the right-hand side of a set operation (see
+    linkage): true for DISTINCT, false for ALL. Unlike for a plain UNION or
+    INTERSECT, the last DISTINCT operator does not tell which of the
+    operators of an EXCEPT, or of a query expression that mixes set
+    operations, count duplicates, so this is kept for every query block.
+  */
+  bool set_operation_distinct{false};
+
   /**
     result of this query can't be cached, bit field, can be :
       UNCACHEABLE_DEPENDENT
@@ -2357,6 +2392,11 @@ inline bool Query_expression::is_intersect() const {
         first_query_block()->next_query_block()->linkage == INTERSECT_TYPE;
 }
 
+inline bool Query_expression::is_except() const {
+    return first_query_block()->next_query_block() &&
+        first_query_block()->next_query_block()->linkage == EXCEPT_TYPE;
+}
+
 /// Utility RAII class to save/modify/restore the condition_context information
 /// of a query block. @see enum_condition_context.
 class Condition_context {
@@ -4119,6 +4159,7 @@ struct LEX : public Query_tables_list {
   /// Create query block and attach it to the current query expression.
   Query_block *new_union_query(Query_block *curr_query_block, bool distinct);
   Query_block* new_intersect_query(Query_block* curr_query_block, bool distinct);
+  Query_block* new_except_query(Query_block* curr_query_block, bool distinct);
 
   /// Create top-level query expression and query block.
   bool new_top_level_query();
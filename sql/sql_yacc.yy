@@ -1456,7 +1456,7 @@ void warn_about_deprecated_binary(THD *thd)
         udf_type if_exists
         opt_no_write_to_binlog
         all_or_any opt_distinct
-        fulltext_options union_option intersect_option
+        fulltext_options union_option intersect_option except_option
         transaction_access_mode_types
         opt_natural_language_mode opt_query_expansion
         opt_ev_status opt_ev_on_completion ev_on_completion opt_ev_comment
@@ -9881,7 +9881,7 @@ query_expression_body:
           }
         | query_expression_parens INTERSECT_SYM intersect_option query_primary
           {
-            $$ = NEW_PTN PT_intersect($1, @1, $3, $4);
+            $$ = NEW_PTN PT_intersect($1, @1, $3, $4, false, true);
           }
         | query_expression_body INTERSECT_SYM intersect_option query_expression_parens
           {
@@ -9889,7 +9889,23 @@ query_expression_body:
           }
         | query_expression_parens INTERSECT_SYM intersect_option query_expression_parens
           {
-            $$ = NEW_PTN PT_intersect($1, @1, $3, $4, true);
+            $$ = NEW_PTN PT_intersect($1, @1, $3, $4, true, true);
+          }
+        | query_expression_body EXCEPT_SYM except_option query_primary
+          {
+            $$ = NEW_PTN PT_except($1, @1, $3, $4);
+          }
+        | query_expression_parens EXCEPT_SYM except_option query_primary
+          {
+            $$ = NEW_PTN PT_except($1, @1, $3, $4);
+          }
+        | query_expression_body EXCEPT_SYM except_option query_expression_parens
+          {
+            $$ = NEW_PTN PT_except($1, @1, $3, $4, true);
+          }
+        | query_expression_parens EXCEPT_SYM except_option query_expression_parens
+          {
+            $$ = NEW_PTN PT_except($1, @1, $3, $4, true);
           }
         ;
 
@@ -16985,6 +17001,12 @@ union_option:
         | ALL       { $$=0; }
         ;
 
+except_option:
+          /* empty */ { $$=1; }
+        | DISTINCT  { $$=1; }
+        | ALL       { $$=0; }
+        ;
+
 row_subquery:
           subquery
         ;